@@ -21,17 +21,32 @@
 #include <vol3dsimple.h>
 #include <volumeloader.h>
 #include <thresholdtools.h>
-#include <DS/morph32.h>
-#include <DS/runlengthsegmenter.h>
+#include <vol3dquantile.h>
+#include <DS/morphpipeline.h>
+#include <sstream>
 
-template <class T>
-T nthValue(const Vol3D<T> &vIn, size_t n)
+// Finds the brightest voxel above the threshold whose 6 neighbors are also above it, so that an
+// isolated bright voxel is not chosen. Returns false if there is none.
+static bool brightestCore(int &xMax, int &yMax, int &zMax, const Vol3D<float32> &vIn, const float32 threshold)
 {
-  const auto ds=vIn.size();
-  auto v=std::vector<T>(vIn.size());
-  for (size_t i=0;i<ds;i++) v[i]=vIn[i];
-  std::nth_element(v.begin(), v.begin()+n, v.end());
-  return v[n];
+  bool found = false;
+  float32 best = threshold;
+  const int cx = int(vIn.cx), cy = int(vIn.cy), cz = int(vIn.cz);
+  for (int z=1;z+1<cz;z++)
+    for (int y=1;y+1<cy;y++)
+      for (int x=1;x+1<cx;x++)
+      {
+        const float32 f = vIn(x,y,z);
+        if ((f<=best)&&found) continue;
+        if (f<=threshold) continue;
+        if ((vIn(x-1,y,z)<=threshold)||(vIn(x+1,y,z)<=threshold)) continue;
+        if ((vIn(x,y-1,z)<=threshold)||(vIn(x,y+1,z)<=threshold)) continue;
+        if ((vIn(x,y,z-1)<=threshold)||(vIn(x,y,z+1)<=threshold)) continue;
+        best = f;
+        xMax = x; yMax = y; zMax = z;
+        found = true;
+      }
+  return found;
 }
 
 int main(int argc, char *argv[])
@@ -40,33 +55,79 @@ int main(int argc, char *argv[])
   ap.description="removes background noise by applying a threshold and performing mathematical morphology operations.";
   std::string mfname;
   float level=0.5f;
+  int nThreads=0;
+  std::string recipe=MorphPipeline::defaultRecipe;
+  bool noCrop=false;
+  bool mapInput=false;
+  std::string seed;
+  int gzLevel=Vol3DBase::compressionLevel;
   ap.bind("m",mfname,"<mask_file>","save initial threshold output",false,false);
   ap.bind("-level",level,"<level>","level for threshold [0-1]",true,false);
+  ap.bind("t",nThreads,"<n>","number of threads (0 uses all available)",false,false);
+  ap.bind("-ops",recipe,"<ops>","morphology recipe: comma-separated list of eC,eR,dC,dR,eB,dB,eS,dS,eO2,dO2,fg,bg,fill",false,false);
+  ap.bind("-seed",seed,"<x,y,z|center|brightest>","keep the foreground component containing this voxel instead of the largest",false,false);
+  ap.bind("-gzlevel",gzLevel,"<0-9>","gzip level for .gz outputs (1 is fastest)",false,false);
+  ap.bindFlag("-nocrop",noCrop,"process the full volume instead of the bounding box of the thresholded foreground");
+  ap.bindFlag("-mmap",mapInput,"memory-map uncompressed inputs instead of reading them into memory");
 
   if (!ap.parseAndValidate(argc,argv)) return ap.usage();
+  SILT::ThreadControl::setThreads(nThreads);
+  if ((gzLevel<0)||(gzLevel>9))
+  {
+    std::cerr<<"error: gzip level must be between 0 and 9"<<std::endl;
+    return 1;
+  }
+  Vol3DBase::compressionLevel = gzLevel;
+  Vol3DBase::memoryMap = mapInput;
+  MorphPipeline pipeline;
+  if (!pipeline.parse(recipe)) return 1;
+  pipeline.verbose = (ap.verbosity>0);
+  pipeline.cropToForeground = !noCrop;
+  if (seed=="center")
+    pipeline.seedMode = MorphPipeline::CenterSeed;
+  else if (!seed.empty() && seed!="brightest")
+  {
+    std::istringstream istr(seed);
+    char c1=0, c2=0;
+    if (!(istr>>pipeline.seedX>>c1>>pipeline.seedY>>c2>>pipeline.seedZ) || c1!=',' || c2!=',')
+    {
+      std::cerr<<"error: could not parse seed \""<<seed<<"\""<<std::endl;
+      return 1;
+    }
+    pipeline.seedMode = MorphPipeline::PointSeed;
+  }
+  if (pipeline.verbose) std::cout<<"plan: "<<pipeline.describe()<<std::endl;
   Vol3D<float32> vIn;
+  Vol3DQuantile::TopDigits<float32> topDigits;
+  vIn.readProcessor = [&topDigits](float32 *first, float32 *last, const int worker) { topDigits.add(first,last,worker); };
   if (!vIn.read(ap.ifname)) return CommonErrors::cantRead(ap.ifname);
-  float f=nthValue(vIn,level*vIn.size());
+  vIn.readProcessor = nullptr;
+  const auto hgram = topDigits.merged();
+  float f=Vol3DQuantile::nthValue(vIn,level*vIn.size(),&hgram);
   std::cout<<ap.ifname<<" : "<<f<<std::endl;
+  if (seed=="brightest")
+  {
+    if (brightestCore(pipeline.seedX,pipeline.seedY,pipeline.seedZ,vIn,f))
+    {
+      pipeline.seedMode = MorphPipeline::PointSeed;
+      if (pipeline.verbose) std::cout<<"seed: ("<<pipeline.seedX<<","<<pipeline.seedY<<","<<pipeline.seedZ<<")"<<std::endl;
+    }
+    else
+      std::cerr<<"warning: no voxel above the threshold for the seed; keeping the largest component"<<std::endl;
+  }
+  Vol3D<VBit> vBit;
+  ThresholdTools::thresholdT(vBit,vIn,f);
   Vol3D<uint8> vMask;
-  vMask.makeCompatible(vIn);
-  for (int i=0;i<vIn.size();i++) vMask[i] = (vIn[i]>f) ? 255 : 0;
   if (!mfname.empty())
+  {
+    vBit.decode(vMask);
     if (!vMask.write(mfname)) return CommonErrors::cantWrite(mfname);
-  Vol3D<VBit> vBit;
-  vBit.encode(vMask);
-  Morph32 dmorph;
-  RunLengthSegmenter rls;
-  dmorph.erodeC(vBit);
-  dmorph.erodeR(vBit);
-  rls.segmentFG(vBit);
-  dmorph.dilateC(vBit);
-  dmorph.dilateR(vBit);
-  dmorph.dilateC(vBit);
-  dmorph.dilateR(vBit);
-  dmorph.erodeC(vBit);
-  dmorph.erodeR(vBit);
-  rls.segmentBG(vBit);
+  }
+  if (!pipeline.run(vBit))
+  {
+    std::cerr<<"error: morphology pipeline failed"<<std::endl;
+    return 1;
+  }
   vBit.decode(vMask);
   if (!vMask.write(ap.ofname)) return CommonErrors::cantWrite(ap.ofname);
 	return 0;
@@ -22,6 +22,12 @@
 #define ThresholdTools_H
 
 #include <vol3d.h>
+#include <vbit.h>
+#include <vol3dquantile.h>
+#include <DS/parallelfor.h>
+#include <DS/runmask.h>
+#include <cmath>
+#include <limits>
 
 class ThresholdTools {
 public:
@@ -52,6 +58,99 @@ public:
     }
     return true;
   }
+  template <class T, class Pred>
+  static bool thresholdBits(Vol3D<VBit> &mask, const Vol3D<T> &vol, Pred pred)
+  // packs pred(voxel) directly into the bit mask, one scanline at a time; scanlines are split across threads
+  {
+    if (!mask.makeCompatible(vol)) return false;
+    const size_t cx = vol.cx;
+    const size_t wpl = wordsPerLine(cx);
+    const size_t fullWords = cx/32;
+    const int extra = cx&0x1F;
+    const T *src = vol.start();
+    uint32 *dst = mask.raw32();
+    SILT::parallelFor(vol.cy*vol.cz,[&](const size_t firstLine, const size_t lastLine, const int)
+    {
+      uint8 flags[32];
+      for (size_t line=firstLine;line<lastLine;line++)
+      {
+        const T *v = src + line*cx;
+        uint32 *w = dst + line*wpl;
+        for (size_t i=0;i<fullWords;i++,v+=32)
+        {
+          for (int b=0;b<32;b++) flags[b] = pred(v[b]) ? 0xFF : 0;
+          *w++ = Codec32::packWord(flags);
+        }
+        if (extra)
+        {
+          for (int b=0;b<32;b++) flags[b] = ((b<extra) && pred(v[b])) ? 0xFF : 0;
+          *w = Codec32::packWord(flags);
+        }
+      }
+    },(64*1024)/(cx+1)+1);
+    return true;
+  }
+  template <class T, class Sink>
+  static bool withThresholdPredicate(const double thresholdValue, Sink &&sink)
+  // calls sink(pred) with a predicate on T that is true iff the voxel is above thresholdValue
+  {
+    if constexpr (std::is_floating_point_v<T>)
+    {
+      const T t = floatBelow<T>(thresholdValue); // v>t iff v>thresholdValue
+      return sink([t](const T v) { return v>t; });
+    }
+    else
+    {
+      if (std::isnan(thresholdValue)||(thresholdValue>=double(std::numeric_limits<T>::max())))
+        return sink([](const T) { return false; });
+      if (thresholdValue<double(std::numeric_limits<T>::min()))
+        return sink([](const T) { return true; });
+      const T t = static_cast<T>(std::floor(thresholdValue));
+      return sink([t](const T v) { return v>t; });
+    }
+  }
+  template <class T>
+  static bool thresholdT(Vol3D<VBit> &mask, const Vol3D<T> &vol, const double thresholdValue)
+  // same result as thresholdT(Vol3D<uint8>&,...), but with the comparison done in the voxel type so it vectorizes
+  {
+    return withThresholdPredicate<T>(thresholdValue,[&](auto pred) { return thresholdBits(mask,vol,pred); });
+  }
+  template <class T>
+  static bool thresholdT(RunMask &mask, const Vol3D<T> &vol, const double thresholdValue)
+  // same result as thresholdT(Vol3D<VBit>&,...), encoded directly as runs
+  {
+    return withThresholdPredicate<T>(thresholdValue,[&](auto pred) { return mask.encodeIf(vol,pred); });
+  }
+  template <class T>
+  static T floatBelow(const double value)
+  // largest T that is <= value
+  {
+    if (value>double(std::numeric_limits<T>::max())) return std::numeric_limits<T>::max();
+    if (value<double(std::numeric_limits<T>::lowest())) return -std::numeric_limits<T>::infinity();
+    const T t = static_cast<T>(value);
+    return (t>value) ? std::nextafter(t,-std::numeric_limits<T>::infinity()) : t;
+  }
+  static bool threshold(Vol3D<VBit> &mask, const Vol3DBase *vol, const double thresholdValue)
+  {
+    if (!vol) return false;
+    switch (vol->typeID())
+    {
+      case SILT::Uint8 : return thresholdT(mask,*static_cast<const Vol3D<uint8 > *>(vol),thresholdValue); break;
+      case SILT::Sint8 : return thresholdT(mask,*static_cast<const Vol3D<sint8 > *>(vol),thresholdValue); break;
+      case SILT::Sint16: return thresholdT(mask,*static_cast<const Vol3D<sint16> *>(vol),thresholdValue); break;
+      case SILT::Uint16: return thresholdT(mask,*static_cast<const Vol3D<uint16> *>(vol),thresholdValue); break;
+      case SILT::Sint32: return thresholdT(mask,*static_cast<const Vol3D<sint32> *>(vol),thresholdValue); break;
+      case SILT::Uint32: return thresholdT(mask,*static_cast<const Vol3D<uint32> *>(vol),thresholdValue); break;
+      case SILT::Float32: return thresholdT(mask,*static_cast<const Vol3D<float32> *>(vol),thresholdValue); break;
+      case SILT::Float64: return thresholdT(mask,*static_cast<const Vol3D<float64> *>(vol),thresholdValue); break;
+      case SILT::RGB8: return thresholdBits(mask,*static_cast<const Vol3D<rgb8> *>(vol),[thresholdValue](const rgb8 &v) { return v.r>thresholdValue; }); break;
+      case SILT::Eigensystem3x3f: return thresholdBits(mask,*static_cast<const Vol3D<EigenSystem3x3f> *>(vol),[thresholdValue](const EigenSystem3x3f &e) { return fractionalAnisotropy(e)>thresholdValue; }); break;
+      default:
+        std::cerr<<"unable to mask datatype "<<vol->datatypeName()<<std::endl;
+        break;
+    }
+    return false;
+  }
   static float fractionalAnisotropy(const EigenSystem3x3f &e)
   {
     float d=(e.l0*e.l0+e.l1*e.l1+e.l2*e.l2);
@@ -104,6 +203,33 @@ public:
     }
     return false;
   }
+  static double nthValue(const Vol3DBase *vol, const size_t n)
+  // returns the n-th smallest value of the quantity that threshold() compares against
+  {
+    if (!vol) return 0;
+    switch (vol->typeID())
+    {
+      case SILT::Uint8 : return Vol3DQuantile::nthValue(*static_cast<const Vol3D<uint8 > *>(vol),n); break;
+      case SILT::Sint8 : return Vol3DQuantile::nthValue(*static_cast<const Vol3D<sint8 > *>(vol),n); break;
+      case SILT::Sint16: return Vol3DQuantile::nthValue(*static_cast<const Vol3D<sint16> *>(vol),n); break;
+      case SILT::Uint16: return Vol3DQuantile::nthValue(*static_cast<const Vol3D<uint16> *>(vol),n); break;
+      case SILT::Sint32: return Vol3DQuantile::nthValue(*static_cast<const Vol3D<sint32> *>(vol),n); break;
+      case SILT::Uint32: return Vol3DQuantile::nthValue(*static_cast<const Vol3D<uint32> *>(vol),n); break;
+      case SILT::Float32: return Vol3DQuantile::nthValue(*static_cast<const Vol3D<float32> *>(vol),n); break;
+      case SILT::Float64: return Vol3DQuantile::nthValue(*static_cast<const Vol3D<float64> *>(vol),n); break;
+      case SILT::RGB8: return Vol3DQuantile::nthValue(*static_cast<const Vol3D<rgb8> *>(vol),n); break;
+      case SILT::Eigensystem3x3f:
+        {
+          const auto &v = *static_cast<const Vol3D<EigenSystem3x3f> *>(vol);
+          return Vol3DQuantile::nthValue(v.start(),v.size(),n,fractionalAnisotropy);
+        }
+        break;
+      default:
+        std::cerr<<"unable to compute order statistics for datatype "<<vol->datatypeName()<<std::endl;
+        break;
+    }
+    return 0;
+  }
   template <class T>
   static bool thresholdT(Vol3D<uint8> &mask, const Vol3D<T> &vol, const double thresholdValueMin, const double thresholdValueMax)
   {
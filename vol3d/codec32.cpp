@@ -20,46 +20,55 @@
 //
 
 #include <DS/codec32.h>
+#include <DS/parallelfor.h>
+#include <algorithm>
+
+namespace {
+inline size_t minLines(const int cx) { return (64*1024)/(size_t(cx)+1) + 1; }
+}
 
 void Codec32::encode(const uint8 *data, uint32 *code, const int cx, const int cy, const int cz)
 {
-  auto *cptr  = code;
-	for (int z=0;z<cz;z++)
-	{
-		for (int y=0;y<cy;y++)
-		{
-      auto *dptr = data + y*cx + cx*cy*z;
-      uint32 val = 0;
-			int p = 0;
-			for (int x=0;x<cx;x++,dptr++)
-			{
-        val>>=1;
-        val |= (uint32)((*dptr)&(0x01))<<31;
-				if (((++p) &= 0x1F)==0) { *cptr++ = val; }
-			}
-			if ((p)!=0) { *cptr++ = val>>(32-p); }
-		}
-	}
+  const size_t nLines = size_t(cy)*size_t(cz);
+  const size_t wpl = (size_t(cx)+31)>>5;
+  const size_t fullWords = cx>>5;
+  const int extra = cx&0x1F;
+  SILT::parallelFor(nLines,[&](const size_t firstLine, const size_t lastLine, const int)
+  {
+    uint8 tail[32] = {0};
+    for (size_t line=firstLine;line<lastLine;line++)
+    {
+      const uint8 *dptr = data + line*cx;
+      uint32 *cptr = code + line*wpl;
+      for (size_t w=0;w<fullWords;w++,dptr+=32) cptr[w] = packWord(dptr);
+      if (extra)
+      {
+        std::copy(dptr,dptr+extra,tail);
+        cptr[fullWords] = packWord(tail);
+      }
+    }
+  },minLines(cx));
 }
 
 void Codec32::decode(const uint32 *code, uint8 *data, const int cx, const int cy, const int cz)
 {
-  auto *cptr  = code;
-	for (int z=0;z<cz;z++)
-	{
-		for (int y=0;y<cy;y++)
-		{
-			uint8 *dptr = data + y*cx + cx*cy*z;
-      uint32 val=0;
-			int p = 0;
-			for (int x=0;x<cx;x++)
-			{
-				if (p==0) { val = *(cptr++); }
-				(++p) &= 0x1F;
-        *dptr++ = 0xFF * (val & 1);
-        val >>=1;
-			}
-		}
-	}
+  const size_t nLines = size_t(cy)*size_t(cz);
+  const size_t wpl = (size_t(cx)+31)>>5;
+  const size_t fullWords = cx>>5;
+  const int extra = cx&0x1F;
+  SILT::parallelFor(nLines,[&](const size_t firstLine, const size_t lastLine, const int)
+  {
+    uint8 tail[32];
+    for (size_t line=firstLine;line<lastLine;line++)
+    {
+      uint8 *dptr = data + line*cx;
+      const uint32 *cptr = code + line*wpl;
+      for (size_t w=0;w<fullWords;w++,dptr+=32) unpackWord(cptr[w],dptr);
+      if (extra)
+      {
+        unpackWord(cptr[fullWords],tail);
+        std::copy(tail,tail+extra,dptr);
+      }
+    }
+  },minLines(cx));
 }
-
@@ -0,0 +1,59 @@
+// Copyright (C) 2025 The Regents of the University of California
+//
+// Created by David W. Shattuck, Ph.D.
+//
+// This file is part of maskbackgroundnoise.
+//
+// maskbackgroundnoise is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, version 2.1.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+
+#include <DS/codec64.h>
+#include <algorithm>
+
+void Codec64::encode(const uint8 *data, uint64 *code, const int cx, const int cy, const int cz, const size_t wpl)
+{
+  const size_t nLines = size_t(cy)*size_t(cz);
+  const size_t fullWords = cx>>6;
+  const int extra = cx&0x3F;
+  for (size_t line=0;line<nLines;line++)
+  {
+    const uint8 *dptr = data + line*cx;
+    uint64 *cptr = code + line*wpl;
+    for (size_t w=0;w<fullWords;w++,dptr+=64) cptr[w] = packWord(dptr);
+    size_t w = fullWords;
+    if (extra)
+    {
+      uint64 val = 0;
+      for (int b=0;b<extra;b++) val |= uint64(dptr[b]&1)<<b;
+      cptr[w++] = val;
+    }
+    std::fill(cptr+w,cptr+wpl,0);
+  }
+}
+
+void Codec64::decode(const uint64 *code, uint8 *data, const int cx, const int cy, const int cz, const size_t wpl)
+{
+  const size_t nLines = size_t(cy)*size_t(cz);
+  for (size_t line=0;line<nLines;line++)
+  {
+    uint8 *dptr = data + line*cx;
+    const uint64 *cptr = code + line*wpl;
+    for (int x=0;x<cx;x+=64)
+    {
+      uint64 val = *cptr++;
+      const int n = std::min(64,cx-x);
+      for (int b=0;b<n;b++,val>>=1) *dptr++ = uint8(0xFF * (val & 1));
+    }
+  }
+}
@@ -0,0 +1,250 @@
+// Copyright (C) 2025 The Regents of the University of California
+//
+// Created by David W. Shattuck, Ph.D.
+//
+// This file is part of maskbackgroundnoise.
+//
+// maskbackgroundnoise is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, version 2.1.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+
+#include <DS/gzindex.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <cstring>
+
+namespace {
+const size_t chunkSize = 1<<16; // file input buffer size
+const char sidecarMagic[8] = {'S','I','L','T','G','Z','I','1'};
+const uint32_t byteOrderMark = 0x01020304;
+
+template <class V> bool writeValue(std::ofstream &ofile, const V &v) { return bool(ofile.write(reinterpret_cast<const char *>(&v),sizeof(v))); }
+template <class V> bool readValue(std::ifstream &ifile, V &v) { return bool(ifile.read(reinterpret_cast<char *>(&v),sizeof(v))); }
+
+struct Inflater {
+  Inflater() { strm.zalloc = Z_NULL; strm.zfree = Z_NULL; strm.opaque = Z_NULL; strm.avail_in = 0; strm.next_in = Z_NULL; }
+  ~Inflater() { if (initialized) inflateEnd(&strm); }
+  bool init(const int windowBits) { initialized = (inflateInit2(&strm,windowBits)==Z_OK); return initialized; }
+  z_stream strm;
+  bool initialized=false;
+};
+}
+
+namespace SILT {
+
+bool GZIndex::fileStamp(const std::string &gzname, uint64_t &fileSize_, int64_t &modified_)
+{
+  std::error_code ec;
+  fileSize_ = std::filesystem::file_size(gzname,ec);
+  if (ec) return false;
+  modified_ = static_cast<int64_t>(std::filesystem::last_write_time(gzname,ec).time_since_epoch().count());
+  return !ec;
+}
+
+bool GZIndex::build(const std::string &gzname, const uint64_t span)
+{
+  points.clear();
+  length = 0;
+  filename = gzname;
+  if (!fileStamp(gzname,fileSize,modified)) return false;
+  std::ifstream ifile(gzname.c_str(),std::ios::binary);
+  if (!ifile) return false;
+  Inflater inflater;
+  if (!inflater.init(15+16)) return false;
+  z_stream &strm = inflater.strm;
+  std::vector<unsigned char> input(chunkSize), window(windowSize);
+  uint64_t totin=0, totout=0, last=0;
+  int status=Z_OK;
+  strm.avail_out = 0;
+  for (bool done=false;!done;)
+  {
+    ifile.read(reinterpret_cast<char *>(input.data()),input.size());
+    strm.avail_in = uInt(ifile.gcount());
+    strm.next_in = input.data();
+    if (strm.avail_in==0) return false; // truncated
+    do
+    {
+      if (strm.avail_out==0) { strm.avail_out = windowSize; strm.next_out = window.data(); }
+      totin += strm.avail_in;
+      totout += strm.avail_out;
+      status = inflate(&strm,Z_BLOCK);
+      totin -= strm.avail_in;
+      totout -= strm.avail_out;
+      if ((status==Z_NEED_DICT)||(status==Z_DATA_ERROR)||(status==Z_MEM_ERROR)||(status==Z_STREAM_ERROR)) return false;
+      if (status==Z_STREAM_END)
+      {
+        if ((strm.avail_in==0) && (ifile.peek()==EOF)) { done=true; break; }
+        if (inflateReset(&strm)!=Z_OK) return false; // another member follows
+        continue;
+      }
+// at the end of a block (but not the last one) all of the block's output has been delivered and none
+// of the following input has been consumed, except for up to 7 bits
+      if ((strm.data_type&128) && !(strm.data_type&64) && ((totout==0)||(totout-last>span)))
+      {
+        const size_t left = strm.avail_out;
+        Point point{totout,totin,strm.data_type&7,std::vector<unsigned char>(windowSize)};
+        std::copy(window.end()-left,window.end(),point.window.begin());
+        std::copy(window.begin(),window.end()-left,point.window.begin()+left);
+        points.push_back(std::move(point));
+        last = totout;
+      }
+    } while (strm.avail_in!=0);
+  }
+  length = totout;
+  return !points.empty();
+}
+
+bool GZIndex::read(void *dst, const uint64_t offset, const size_t len) const
+{
+  if (points.empty() || (offset+len>length)) return false;
+  if (len==0) return true;
+  size_t p=0;
+  while ((p+1<points.size()) && (points[p+1].out<=offset)) p++;
+  const Point &here = points[p];
+  std::ifstream ifile(filename.c_str(),std::ios::binary);
+  if (!ifile) return false;
+  Inflater inflater;
+  if (!inflater.init(-15)) return false; // raw inflate
+  z_stream &strm = inflater.strm;
+  ifile.seekg(std::streamoff(here.in-(here.bits ? 1 : 0)),std::ios::beg);
+  if (here.bits)
+  {
+    const int c = ifile.get();
+    if (c==EOF) return false;
+    inflatePrime(&strm,here.bits,c>>(8-here.bits));
+  }
+  inflateSetDictionary(&strm,here.window.data(),windowSize);
+  std::vector<unsigned char> input(chunkSize), discard(windowSize);
+  auto refill = [&]()
+  {
+    if (strm.avail_in>0) return true;
+    ifile.read(reinterpret_cast<char *>(input.data()),input.size());
+    strm.avail_in = uInt(ifile.gcount());
+    strm.next_in = input.data();
+    return strm.avail_in>0;
+  };
+  uint64_t skip = offset-here.out;
+  unsigned char *out = static_cast<unsigned char *>(dst);
+  size_t remaining = len;
+  bool memberEnded = false;
+  while (remaining>0)
+  {
+    if (skip>0)
+    {
+      strm.next_out = discard.data();
+      strm.avail_out = uInt(std::min<uint64_t>(skip,windowSize));
+    }
+    else
+    {
+      strm.next_out = out;
+      strm.avail_out = uInt(std::min<size_t>(remaining,size_t(1)<<30));
+    }
+    const uInt requested = strm.avail_out;
+    while (strm.avail_out>0)
+    {
+      if (memberEnded)
+      {
+// skip the trailer of the member that ended and the header of the member that follows
+        for (int trailer=0;trailer<8;trailer++)
+        {
+          if (!refill()) return false;
+          strm.next_in++;
+          strm.avail_in--;
+        }
+        if (inflateReset2(&strm,15+16)!=Z_OK) return false;
+        do
+        {
+          if (!refill()) return false;
+          const int headerStatus = inflate(&strm,Z_BLOCK);
+          if ((headerStatus==Z_DATA_ERROR)||(headerStatus==Z_MEM_ERROR)||(headerStatus==Z_STREAM_ERROR)) return false;
+        } while ((strm.data_type&128)==0);
+        if (inflateReset2(&strm,-15)!=Z_OK) return false;
+        memberEnded = false;
+      }
+      if (!refill()) return false;
+      const int status = inflate(&strm,Z_NO_FLUSH);
+      if ((status==Z_NEED_DICT)||(status==Z_DATA_ERROR)||(status==Z_MEM_ERROR)||(status==Z_STREAM_ERROR)) return false;
+      memberEnded = (status==Z_STREAM_END);
+    }
+    const size_t produced = requested;
+    if (skip>0)
+      skip -= produced;
+    else
+    {
+      out += produced;
+      remaining -= produced;
+    }
+  }
+  return true;
+}
+
+bool GZIndex::save(const std::string &indexname) const
+{
+  std::ofstream ofile(indexname.c_str(),std::ios::binary);
+  if (!ofile) return false;
+  ofile.write(sidecarMagic,sizeof(sidecarMagic));
+  writeValue(ofile,byteOrderMark);
+  writeValue(ofile,fileSize);
+  writeValue(ofile,modified);
+  writeValue(ofile,length);
+  writeValue(ofile,uint64_t(points.size()));
+  for (auto &point : points)
+  {
+    writeValue(ofile,point.out);
+    writeValue(ofile,point.in);
+    writeValue(ofile,int32_t(point.bits));
+    ofile.write(reinterpret_cast<const char *>(point.window.data()),windowSize);
+  }
+  return bool(ofile);
+}
+
+bool GZIndex::load(const std::string &indexname, const std::string &gzname)
+{
+  points.clear();
+  length = 0;
+  filename = gzname;
+  std::ifstream ifile(indexname.c_str(),std::ios::binary);
+  if (!ifile) return false;
+  char magic[sizeof(sidecarMagic)];
+  uint32_t mark=0;
+  uint64_t indexedSize=0, nPoints=0;
+  int64_t indexedTime=0;
+  if (!ifile.read(magic,sizeof(magic)) || std::memcmp(magic,sidecarMagic,sizeof(magic))!=0) return false;
+  if (!readValue(ifile,mark) || (mark!=byteOrderMark)) return false;
+  if (!readValue(ifile,indexedSize) || !readValue(ifile,indexedTime) || !readValue(ifile,length) || !readValue(ifile,nPoints)) return false;
+  if (!fileStamp(gzname,fileSize,modified) || (fileSize!=indexedSize) || (modified!=indexedTime)) return false;
+  if (nPoints==0 || nPoints>fileSize) return false;
+  points.resize(nPoints);
+  for (auto &point : points)
+  {
+    int32_t bits=0;
+    point.window.resize(windowSize);
+    if (!readValue(ifile,point.out) || !readValue(ifile,point.in) || !readValue(ifile,bits)) { points.clear(); return false; }
+    point.bits = bits;
+    if (!ifile.read(reinterpret_cast<char *>(point.window.data()),windowSize)) { points.clear(); return false; }
+  }
+  return true;
+}
+
+bool GZIndex::open(const std::string &gzname, const uint64_t span)
+{
+  const std::string indexname = sidecarName(gzname);
+  if (load(indexname,gzname)) return true;
+  if (!build(gzname,span)) return false;
+  if (!save(indexname))
+    std::cerr<<"warning: unable to save index "<<indexname<<std::endl;
+  return true;
+}
+
+} // end of namespace SILT
@@ -0,0 +1,215 @@
+// Copyright (C) 2025 The Regents of the University of California
+//
+// Created by David W. Shattuck, Ph.D.
+//
+// This file is part of maskbackgroundnoise.
+//
+// maskbackgroundnoise is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, version 2.1.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+
+#include <DS/gzmembers.h>
+#include <DS/parallelfor.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+namespace SILT {
+
+// deflates bytes [first,last) of the queued stream into a complete gzip member
+bool GZMemberWriter::compressBlock(std::vector<unsigned char> &member, const size_t first, const size_t last) const
+{
+  z_stream strm;
+  strm.zalloc = Z_NULL;
+  strm.zfree = Z_NULL;
+  strm.opaque = Z_NULL;
+  if (deflateInit2(&strm,level,Z_DEFLATED,15+16,8,Z_DEFAULT_STRATEGY)!=Z_OK) return false;
+  unsigned char extra[GZMemberHeader::extraLen]={GZMemberHeader::subfieldID1,GZMemberHeader::subfieldID2,GZMemberHeader::subfieldLen,0};
+  GZMemberHeader::putUint32(extra+8,uint32(last-first));
+  gz_header head={};
+  head.extra = extra;
+  head.extra_len = GZMemberHeader::extraLen;
+  head.os = 255;
+  deflateSetHeader(&strm,&head);
+  member.resize(deflateBound(&strm,uLong(last-first)));
+  strm.next_out = member.data();
+  strm.avail_out = uInt(member.size());
+  size_t offset=0;
+  int status=Z_OK;
+  for (auto &segment : segments)
+  {
+    const size_t segFirst=std::max(first,offset);
+    const size_t segLast=std::min(last,offset+segment.len);
+    offset += segment.len;
+    if (segFirst>=segLast) continue;
+    strm.next_in = const_cast<unsigned char *>(segment.data+(segFirst-(offset-segment.len)));
+    strm.avail_in = uInt(segLast-segFirst);
+    while (strm.avail_in>0 && status==Z_OK)
+    {
+      status = deflate(&strm,Z_NO_FLUSH);
+      if (strm.avail_out==0) // deflateBound should make this unreachable
+      {
+        const size_t used=member.size();
+        member.resize(2*used);
+        strm.next_out = member.data()+used;
+        strm.avail_out = uInt(member.size()-used);
+      }
+    }
+  }
+  while (status==Z_OK)
+  {
+    status = deflate(&strm,Z_FINISH);
+    if (status==Z_OK || status==Z_BUF_ERROR)
+    {
+      const size_t used=member.size()-strm.avail_out;
+      member.resize(2*member.size());
+      strm.next_out = member.data()+used;
+      strm.avail_out = uInt(member.size()-used);
+      status = Z_OK;
+    }
+  }
+  member.resize(member.size()-strm.avail_out);
+  deflateEnd(&strm);
+  if (status!=Z_STREAM_END) return false;
+  GZMemberHeader::putUint32(member.data()+GZMemberHeader::compressedSizeOffset,uint32(member.size()));
+  return true;
+}
+
+bool GZMemberWriter::write(const std::string &ofname) const
+{
+  std::ofstream ofile(ofname.c_str(),std::ios::binary);
+  if (!ofile) return false;
+  size_t total=0;
+  for (auto &segment : segments) total += segment.len;
+  const size_t bs = std::clamp(blockSize,size_t(1)<<16,size_t(1)<<30); // member sizes must fit in 32 bits
+  const size_t nBlocks = std::max(size_t(1),(total+bs-1)/bs); // an empty stream still gets one member
+  const int nt = (nThreads>0) ? nThreads : ThreadControl::nThreads();
+  const size_t batchSize = 4*size_t(nt);
+  std::vector<std::vector<unsigned char>> members(std::min(batchSize,nBlocks));
+  for (size_t batchStart=0;batchStart<nBlocks;batchStart+=batchSize)
+  {
+    const size_t batchEnd = std::min(nBlocks,batchStart+batchSize);
+    std::vector<char> ok(batchEnd-batchStart,0);
+    parallelFor(batchEnd-batchStart,[&](const size_t first, const size_t last, const int)
+    {
+      for (size_t i=first;i<last;i++)
+      {
+        const size_t b = batchStart+i;
+        ok[i] = compressBlock(members[i],b*bs,std::min(total,(b+1)*bs));
+      }
+    },1,nt);
+    for (size_t i=0;i<ok.size();i++)
+    {
+      if (!ok[i]) { std::cerr<<"error compressing "<<ofname<<std::endl; return false; }
+      ofile.write(reinterpret_cast<const char *>(members[i].data()),members[i].size());
+    }
+    if (!ofile) { std::cerr<<"error saving "<<ofname<<std::endl; return false; }
+  }
+  return true;
+}
+
+bool GZMemberReader::open(const std::string &ifname)
+{
+  members.clear();
+  filename = ifname;
+  std::ifstream ifile(ifname.c_str(),std::ios::binary);
+  if (!ifile) return false;
+  ifile.seekg(0,std::ios::end);
+  const uint64_t fileSize = uint64_t(ifile.tellg());
+  uint64_t position=0, offset=0;
+  while (position<fileSize)
+  {
+    unsigned char head[GZMemberHeader::headerSize];
+    ifile.seekg(std::streamoff(position),std::ios::beg);
+    if (!ifile.read(reinterpret_cast<char *>(head),sizeof(head))) { members.clear(); return false; }
+    const bool tagged = (head[0]==0x1f) && (head[1]==0x8b) && (head[2]==Z_DEFLATED) && (head[3]==4)
+      && (head[10]==GZMemberHeader::extraLen) && (head[11]==0)
+      && (head[12]==GZMemberHeader::subfieldID1) && (head[13]==GZMemberHeader::subfieldID2)
+      && (head[14]==GZMemberHeader::subfieldLen) && (head[15]==0);
+    const uint64_t compressedSize = GZMemberHeader::getUint32(head+GZMemberHeader::compressedSizeOffset);
+    if (!tagged || (compressedSize<GZMemberHeader::headerSize+GZMemberHeader::trailerSize) || (position+compressedSize>fileSize))
+    {
+      members.clear();
+      return false;
+    }
+    const uint64_t size = GZMemberHeader::getUint32(head+GZMemberHeader::uncompressedSizeOffset);
+    members.push_back(Member{position,compressedSize,offset,size});
+    position += compressedSize;
+    offset += size;
+  }
+  return !members.empty();
+}
+
+bool GZMemberReader::read(void *dst, const uint64_t offset, const size_t len) const
+{
+  if (offset+len>size()) return false;
+  if (len==0) return true;
+  size_t first=0;
+  while (members[first].offset+members[first].size<=offset) first++;
+  size_t last=first;
+  while ((last<members.size()) && (members[last].offset<offset+len)) last++;
+  std::ifstream ifile(filename.c_str(),std::ios::binary);
+  if (!ifile) { std::cerr<<"error opening "<<filename<<std::endl; return false; }
+  unsigned char *out = static_cast<unsigned char *>(dst);
+  const int nt = (nThreads>0) ? nThreads : ThreadControl::nThreads();
+  const size_t batchSize = 4*size_t(nt);
+  std::vector<unsigned char> compressed;
+  for (size_t batchStart=first;batchStart<last;batchStart+=batchSize)
+  {
+    const size_t batchEnd = std::min(last,batchStart+batchSize);
+    const uint64_t base = members[batchStart].compressedOffset;
+    compressed.resize(members[batchEnd-1].compressedOffset+members[batchEnd-1].compressedSize-base);
+    ifile.seekg(std::streamoff(base),std::ios::beg);
+    if (!ifile.read(reinterpret_cast<char *>(compressed.data()),compressed.size()))
+    {
+      std::cerr<<"error reading "<<filename<<std::endl;
+      return false;
+    }
+    std::vector<char> ok(batchEnd-batchStart,0);
+    parallelFor(batchEnd-batchStart,[&](const size_t i0, const size_t i1, const int)
+    {
+      std::vector<unsigned char> partial;
+      for (size_t i=i0;i<i1;i++)
+      {
+        const Member &m = members[batchStart+i];
+        const bool inside = (m.offset>=offset) && (m.offset+m.size<=offset+len);
+        unsigned char *target;
+        if (inside) target = out+(m.offset-offset);
+        else { partial.resize(m.size); target=partial.data(); }
+        z_stream strm;
+        strm.zalloc = Z_NULL;
+        strm.zfree = Z_NULL;
+        strm.opaque = Z_NULL;
+        strm.next_in = compressed.data()+(m.compressedOffset-base);
+        strm.avail_in = uInt(m.compressedSize);
+        if (inflateInit2(&strm,15+16)!=Z_OK) continue;
+        strm.next_out = target;
+        strm.avail_out = uInt(m.size);
+        const int status = inflate(&strm,Z_FINISH);
+        ok[i] = (status==Z_STREAM_END) && (strm.total_out==m.size) && (strm.avail_in==0);
+        inflateEnd(&strm);
+        if (ok[i] && !inside)
+        {
+          const uint64_t from = std::max(m.offset,offset);
+          const uint64_t to = std::min(m.offset+m.size,offset+len);
+          std::copy(partial.begin()+(from-m.offset),partial.begin()+(to-m.offset),out+(from-offset));
+        }
+      }
+    },1,nt);
+    for (auto memberOK : ok)
+      if (!memberOK) { std::cerr<<"error inflating "<<filename<<std::endl; return false; }
+  }
+  return true;
+}
+
+} // end of namespace SILT
@@ -0,0 +1,68 @@
+// Copyright (C) 2025 The Regents of the University of California
+//
+// Created by David W. Shattuck, Ph.D.
+//
+// This file is part of maskbackgroundnoise.
+//
+// maskbackgroundnoise is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, version 2.1.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+
+
+#ifndef BitScan_H
+#define BitScan_H
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace SILT {
+
+//! \brief Bit scans and counts on 32-bit words, using the compiler intrinsics where available.
+struct BitScan {
+  typedef unsigned int uint32;
+  //! index of the lowest set bit of w; w must not be zero.
+  static int lowest(const uint32 w)
+  {
+#if defined(_MSC_VER)
+    unsigned long i;
+    _BitScanForward(&i,w);
+    return int(i);
+#elif defined(__GNUC__)
+    return __builtin_ctz(w);
+#else
+    int i=0;
+    for (uint32 v=w;(v&1)==0;v>>=1) i++;
+    return i;
+#endif
+  }
+  //! number of set bits of w
+  static int count(const uint32 w)
+  {
+#if defined(__GNUC__) && (defined(__POPCNT__) || defined(__aarch64__))
+    return __builtin_popcount(w);
+#else
+    uint32 v = w - ((w>>1) & 0x55555555);
+    v = (v & 0x33333333) + ((v>>2) & 0x33333333);
+    return int((((v + (v>>4)) & 0x0F0F0F0F) * 0x01010101)>>24);
+#endif
+  }
+  //! bits [first,31] set; first must be in [0,31].
+  static uint32 from(const int first) { return 0xFFFFFFFFu<<first; }
+  //! bits [0,last] set; last must be in [0,31].
+  static uint32 through(const int last) { return 0xFFFFFFFFu>>(31-last); }
+};
+
+} // end of namespace SILT
+
+#endif
@@ -22,10 +22,55 @@
 #ifndef Codec32_H
 #define Codec32_H
 
+#include <cstring>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+//! \brief Converts between byte masks and bit codes stored as 32-bit words, ceil(cx/32) words per scanline.
+//! \details Bit (x&31) of word (x>>5) of a scanline holds voxel x; bits at or beyond cx are written as 0.
+//!          Scanlines are converted in parallel, 32 voxels at a time.
 class Codec32 {
 public:
   typedef unsigned char uint8;
   typedef unsigned int uint32;
+  typedef unsigned long long uint64;
+  static uint32 packWord(const uint8 *bytes)
+  // packs 32 bytes into one code word; bit i is the lowest bit of bytes[i]
+  {
+#if defined(__AVX2__)
+    const __m256i v = _mm256_slli_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(bytes)),7);
+    return uint32(_mm256_movemask_epi8(v));
+#elif defined(__SSE2__) || defined(_M_X64)
+    const __m128i lo = _mm_slli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes)),7);
+    const __m128i hi = _mm_slli_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes+16)),7);
+    return uint32(_mm_movemask_epi8(lo)) | (uint32(_mm_movemask_epi8(hi))<<16);
+#else
+    uint32 word = 0;
+    for (int i=0;i<32;i++) word |= uint32(bytes[i]&1)<<i;
+    return word;
+#endif
+  }
+  static void unpackWord(const uint32 word, uint8 *bytes)
+  // expands one code word into 32 bytes; bytes[i] is 0xFF if bit i is set and 0 otherwise
+  {
+#if defined(__AVX2__)
+    const __m256i select = _mm256_setr_epi8(0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,1,2,2,2,2,2,2,2,2,3,3,3,3,3,3,3,3);
+    const __m256i bits = _mm256_set1_epi64x(0x8040201008040201LL);
+    const __m256i v = _mm256_and_si256(_mm256_shuffle_epi8(_mm256_set1_epi32(int(word)),select),bits);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(bytes),_mm256_cmpeq_epi8(v,bits));
+#else
+    for (int i=0;i<4;i++)
+    {
+      // spread bit k of the byte to byte k, then turn each nonzero byte into 0xFF
+      const uint64 spread = (((word>>(8*i))&0xFF) * 0x0101010101010101ULL) & 0x8040201008040201ULL;
+      const uint64 flags = (((spread + 0x7F7F7F7F7F7F7F7FULL) & 0x8080808080808080ULL)>>7) * 0xFF;
+      std::memcpy(bytes+8*i,&flags,8); // byte k of flags is bytes[8*i+k] on little-endian targets
+    }
+#endif
+  }
   static void encode(const uint8 *data, uint32 *code, const int cx, const int cy, const int cz);
   static void decode(const uint32 *code, uint8 *data, const int cx, const int cy, const int cz);
 };
@@ -1,5 +1,4 @@
-// Copyright (C) 2025 The Regents of the University of California and
-// the University of Southern California
+// Copyright (C) 2025 The Regents of the University of California
 //
 // Created by David W. Shattuck, Ph.D.
 //
@@ -19,39 +18,26 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
 //
 
-#include "graph.h"
+#ifndef Codec64_H
+#define Codec64_H
 
-const int Graph::sentinel = 0;
+#include <DS/codec32.h>
+#include <cstddef>
+#include <cstdint>
 
-int Graph::makemap(LabelT *map)
-{
-  int nLabels = 0;
-  for (int i=0;i<nlists;i++) map[i] = sentinel;
-  for (int i=0;i<nlists;i++)
+//! \brief Converts between byte masks and bit codes stored as 64-bit words with padded scanlines.
+//! \details Bit (x&63) of word (x>>6) holds voxel x. Each scanline occupies wpl words; bits at or
+//!          beyond cx are written as 0.
+class Codec64 {
+public:
+  typedef unsigned char uint8;
+  typedef uint64_t uint64;
+  static uint64 packWord(const uint8 *bytes) // bit i is the lowest bit of bytes[i]
   {
-    if (map[i]==sentinel)
-    {
-      ++nLabels;
-      visit(map, i, nLabels);
-    }
+    return uint64(Codec32::packWord(bytes)) | (uint64(Codec32::packWord(bytes+32))<<32);
   }
-  return nLabels;
-}
+  static void encode(const uint8 *data, uint64 *code, const int cx, const int cy, const int cz, const size_t wpl);
+  static void decode(const uint64 *code, uint8 *data, const int cx, const int cy, const int cz, const size_t wpl);
+};
 
-void Graph::visit(LabelT *map, int iNode, int labels)
-{
-  stack.push_back(iNode);
-  while (stack.size()>0)
-  {
-    iNode = stack.back(); stack.pop_back();
-    map[iNode] = labels;
-    for (auto *node = lists[iNode]; node != 0; node = node->next)
-    {
-      if (map[node->data]==sentinel)
-      {
-        stack.push_back(node->data);
-        map[node->data] = -1;
-      }
-    }
-  }
-}
+#endif
@@ -0,0 +1,68 @@
+// Copyright (C) 2025 The Regents of the University of California
+//
+// Created by David W. Shattuck, Ph.D.
+//
+// This file is part of maskbackgroundnoise.
+//
+// maskbackgroundnoise is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, version 2.1.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+
+#ifndef SILT_GZIndex_H
+#define SILT_GZIndex_H
+
+#include <zstream.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace SILT {
+
+//! \brief Random-access index for a gzip file, following zlib's examples/zran.c.
+//! \details build inflates the file once and records a checkpoint at the first deflate block boundary
+//!          after every span bytes of output: the uncompressed and compressed offsets, the number of
+//!          bits of the boundary byte already consumed, and the 32K window that precedes it. read then
+//!          starts from the last checkpoint before the requested offset, so only up to span bytes are
+//!          inflated and discarded. Multi-member files are supported. The index can be kept in a
+//!          sidecar file next to the .gz; the sidecar records the size and modification time of the
+//!          .gz and is rebuilt when either changes.
+class GZIndex {
+public:
+  static const uint64_t defaultSpan = 4<<20;
+  static const unsigned int windowSize = 32768;
+  struct Point {
+    uint64_t out; // offset in the uncompressed data
+    uint64_t in;  // offset in the file of the first full byte
+    int bits;     // number of bits (1-7) from the byte at in-1, or 0
+    std::vector<unsigned char> window; // preceding 32K of uncompressed data
+  };
+  bool build(const std::string &gzname, const uint64_t span=defaultSpan);
+  bool save(const std::string &indexname) const;
+  bool load(const std::string &indexname, const std::string &gzname); // fails if the index is stale
+  //! loads the sidecar index of gzname, or builds the index and saves the sidecar
+  bool open(const std::string &gzname, const uint64_t span=defaultSpan);
+  bool read(void *dst, const uint64_t offset, const size_t len) const;
+  uint64_t size() const { return length; } // uncompressed bytes
+  static std::string sidecarName(const std::string &gzname) { return gzname + ".gzi"; }
+  std::vector<Point> points;
+private:
+  static bool fileStamp(const std::string &gzname, uint64_t &fileSize, int64_t &modified);
+  std::string filename;
+  uint64_t length=0;
+  uint64_t fileSize=0;
+  int64_t modified=0;
+};
+
+} // end of namespace SILT
+
+#endif
@@ -0,0 +1,87 @@
+// Copyright (C) 2025 The Regents of the University of California
+//
+// Created by David W. Shattuck, Ph.D.
+//
+// This file is part of maskbackgroundnoise.
+//
+// maskbackgroundnoise is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, version 2.1.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+
+#ifndef SILT_GZMembers_H
+#define SILT_GZMembers_H
+
+#include <zstream.h>
+#include <vol3ddatatypes.h>
+#include <string>
+#include <cstdint>
+#include <vector>
+
+namespace SILT {
+
+//! \brief Layout of the gzip member header written by GZMemberWriter.
+//! \details Each member carries an FEXTRA subfield ('S','B') holding the compressed size of the whole
+//!          member and the uncompressed size of its data, both as little-endian uint32, so a reader can
+//!          walk the member boundaries without inflating. The header is a fixed 24 bytes.
+struct GZMemberHeader {
+  enum : size_t { headerSize=24, extraLen=12, subfieldLen=8, compressedSizeOffset=16, uncompressedSizeOffset=20, trailerSize=8 };
+  static const unsigned char subfieldID1='S';
+  static const unsigned char subfieldID2='B';
+  static uint32 getUint32(const unsigned char *p) { return uint32(p[0]) | (uint32(p[1])<<8) | (uint32(p[2])<<16) | (uint32(p[3])<<24); }
+  static void putUint32(unsigned char *p, const uint32 v) { p[0]=uint8(v); p[1]=uint8(v>>8); p[2]=uint8(v>>16); p[3]=uint8(v>>24); }
+};
+
+//! \brief Writes a gzip file as a series of independently compressed members, pigz-style.
+//! \details The queued buffers are treated as one byte stream that is cut into blocks of blockSize
+//!          bytes; each block is deflated on its own thread into a complete gzip member, and the members
+//!          are written in order, so the result is a valid multi-member .gz that any gzip reader
+//!          accepts. Blocks are compressed in batches to bound the memory held for compressed output.
+//!          The buffers are not copied and must remain valid until write returns.
+class GZMemberWriter {
+public:
+  static const size_t defaultBlockSize = 1<<20;
+  GZMemberWriter(const int level_=Z_DEFAULT_COMPRESSION, const size_t blockSize_=defaultBlockSize) : level(level_), blockSize(blockSize_) {}
+  void add(const void *buf, const size_t len) { if (len>0) segments.push_back(Segment{static_cast<const unsigned char *>(buf),len}); }
+  bool write(const std::string &ofname) const;
+  int level;        // zlib level, 0-9 or Z_DEFAULT_COMPRESSION
+  size_t blockSize; // uncompressed bytes per member
+  int nThreads=0;   // 0 uses SILT::ThreadControl::nThreads()
+private:
+  struct Segment { const unsigned char *data; size_t len; };
+  bool compressBlock(std::vector<unsigned char> &member, const size_t first, const size_t last) const;
+  std::vector<Segment> segments;
+};
+
+//! \brief Inflates byte ranges of a file written by GZMemberWriter, one member per task.
+//! \details open walks the member headers and builds the member table from their 'SB' subfields;
+//!          it fails, without reading any data, for files that are not entirely made of such members
+//!          (plain .gz, uncompressed or truncated files), so callers can fall back to a serial stream.
+//!          read loads the compressed bytes of the members that overlap the requested range in batches
+//!          of 4*nThreads members, so memory stays bounded, and inflates each batch concurrently,
+//!          directly into the destination where a member lies wholly inside the range. Each member's
+//!          CRC and length are checked.
+class GZMemberReader {
+public:
+  struct Member { uint64_t compressedOffset, compressedSize, offset, size; };
+  bool open(const std::string &ifname);
+  bool read(void *dst, const uint64_t offset, const size_t len) const;
+  uint64_t size() const { return members.empty() ? 0 : members.back().offset+members.back().size; } // uncompressed bytes
+  std::vector<Member> members;
+  int nThreads=0; // 0 uses SILT::ThreadControl::nThreads()
+private:
+  std::string filename;
+};
+
+} // end of namespace SILT
+
+#endif
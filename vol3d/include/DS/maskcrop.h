@@ -0,0 +1,165 @@
+// Copyright (C) 2025 The Regents of the University of California
+//
+// Created by David W. Shattuck, Ph.D.
+//
+// This file is part of maskbackgroundnoise.
+//
+// maskbackgroundnoise is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, version 2.1.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+
+
+#ifndef MaskCrop_H
+#define MaskCrop_H
+
+#include <vol3d.h>
+#include <vbit.h>
+#include <vbit64.h>
+#include <DS/parallelfor.h>
+#include <algorithm>
+#include <vector>
+
+//! \brief Crops bit volumes (Vol3D<VBit> or Vol3D<VBit64>) to the bounding box of their foreground
+//!        and pastes the processed crop back.
+//! \details Crop boxes start on a 32-voxel word boundary in x, so rows are copied as whole words and
+//!          each voxel keeps its bit position.
+class MaskCrop {
+public:
+  //! half-open voxel ranges [x0,x1) x [y0,y1) x [z0,z1)
+  struct Box {
+    Box() : x0(0), y0(0), z0(0), x1(0), y1(0), z1(0) {}
+    int x0, y0, z0, x1, y1, z1;
+    int cx() const { return x1-x0; }
+    int cy() const { return y1-y0; }
+    int cz() const { return z1-z0; }
+    bool empty() const { return (x1<=x0)||(y1<=y0)||(z1<=z0); }
+    size_t size() const { return empty() ? 0 : size_t(cx())*size_t(cy())*size_t(cz()); }
+  };
+  static size_t lineStride(const Vol3D<VBit> &v) { return wordsPerLine(v.cx); }
+  static size_t lineStride(const Vol3D<VBit64> &v) { return 2*wordsPerLine64(v.cx); }
+  //! the bounding box of the foreground voxels; empty if there are none
+  template <class Bits> static Box boundingBox(const Vol3D<Bits> &v)
+  {
+    const size_t stride = lineStride(v);
+    const size_t used = wordsPerLine(v.cx);
+    const uint32 lastMask = (v.cx&0x1F) ? (uint32(1)<<(v.cx&0x1F))-1 : 0xFFFFFFFF;
+    std::vector<Box> slabBox(SILT::ThreadControl::nThreads());
+    const int nSlabs = SILT::parallelFor(v.cz,[&](const size_t z0, const size_t z1, const int slab)
+    {
+      Box b;
+      b.x0 = v.cx; b.y0 = v.cy; b.z0 = v.cz;
+      for (size_t z=z0;z<z1;z++)
+        for (int y=0;y<int(v.cy);y++)
+        {
+          const uint32 *row = v.craw32() + (z*v.cy+y)*stride;
+          for (size_t w=0;w<used;w++)
+          {
+            const uint32 word = (w+1==used) ? (row[w]&lastMask) : row[w];
+            if (!word) continue;
+            int lo = 0, hi = 31;
+            while (!(word&(uint32(1)<<lo))) lo++;
+            while (!(word&(uint32(1)<<hi))) hi--;
+            b.x0 = std::min(b.x0,int(32*w)+lo);
+            b.x1 = std::max(b.x1,int(32*w)+hi+1);
+            b.y0 = std::min(b.y0,y);
+            b.y1 = std::max(b.y1,y+1);
+            b.z0 = std::min(b.z0,int(z));
+            b.z1 = std::max(b.z1,int(z)+1);
+          }
+        }
+      slabBox[slab] = b;
+    },1,int(slabBox.size()));
+    Box box = slabBox[0];
+    for (int i=1;i<nSlabs;i++)
+    {
+      const Box &b = slabBox[i];
+      if (b.empty()) continue;
+      if (box.empty()) { box = b; continue; }
+      box.x0 = std::min(box.x0,b.x0); box.x1 = std::max(box.x1,b.x1);
+      box.y0 = std::min(box.y0,b.y0); box.y1 = std::max(box.y1,b.y1);
+      box.z0 = std::min(box.z0,b.z0); box.z1 = std::max(box.z1,b.z1);
+    }
+    return box.empty() ? Box() : box;
+  }
+  //! grows box by margin voxels on each side, clipped to the volume; x0 is rounded down to a word boundary
+  static Box expand(const Box &box, const int margin, const int cx, const int cy, const int cz)
+  {
+    Box b;
+    b.x0 = (std::max(0,box.x0-margin)/32)*32;
+    b.y0 = std::max(0,box.y0-margin);
+    b.z0 = std::max(0,box.z0-margin);
+    b.x1 = std::min(cx,box.x1+margin);
+    b.y1 = std::min(cy,box.y1+margin);
+    b.z1 = std::min(cz,box.z1+margin);
+    return b;
+  }
+  //! true if the voxels of a cx x cy x cz volume outside box form a single connected region
+  static bool connectedOutside(const Box &box, const int cx, const int cy, const int cz)
+  {
+    const int nx = (box.x0>0) + (box.x1<cx), ny = (box.y0>0) + (box.y1<cy), nz = (box.z0>0) + (box.z1<cz);
+    const int nAxes = (nx>0) + (ny>0) + (nz>0);
+    return (nAxes>1) || (nx+ny+nz==1);
+  }
+  //! copies the voxels of src in box to dst, which is resized to the box
+  template <class Bits> static bool crop(Vol3D<Bits> &dst, const Vol3D<Bits> &src, const Box &box)
+  {
+    if (!dst.setsize(box.cx(),box.cy(),box.cz())) return false;
+    dst.setres(src.rx,src.ry,src.rz);
+    const size_t srcStride = lineStride(src), dstStride = lineStride(dst);
+    const size_t used = wordsPerLine(dst.cx);
+    const uint32 lastMask = (dst.cx&0x1F) ? (uint32(1)<<(dst.cx&0x1F))-1 : 0xFFFFFFFF;
+    const bool clipped = (box.x1<int(src.cx)); // keep the bits beyond src.cx, as the uncropped volume would
+    SILT::parallelFor(dst.cz,[&](const size_t z0, const size_t z1, const int)
+    {
+      for (size_t z=z0;z<z1;z++)
+        for (int y=0;y<int(dst.cy);y++)
+        {
+          const uint32 *s = src.craw32() + ((z+box.z0)*src.cy+y+box.y0)*srcStride + box.x0/32;
+          uint32 *d = dst.raw32() + (z*dst.cy+y)*dstStride;
+          std::copy(s,s+used,d);
+          if (clipped) d[used-1] &= lastMask;
+          std::fill(d+used,d+dstStride,0);
+        }
+    });
+    return true;
+  }
+  //! writes src into box of dst; voxels of dst outside the box are set to outside
+  template <class Bits> static bool paste(Vol3D<Bits> &dst, const Vol3D<Bits> &src, const Box &box, const bool outside)
+  {
+    if ((src.cx!=uint32(box.cx()))||(src.cy!=uint32(box.cy()))||(src.cz!=uint32(box.cz()))) return false;
+    const size_t srcStride = lineStride(src), dstStride = lineStride(dst);
+    const size_t dstUsed = wordsPerLine(dst.cx), used = wordsPerLine(src.cx);
+    const uint32 dstLastMask = (dst.cx&0x1F) ? (uint32(1)<<(dst.cx&0x1F))-1 : 0xFFFFFFFF;
+    const uint32 fill = outside ? 0xFFFFFFFF : 0;
+    const bool clipped = (box.x1<int(dst.cx));
+    const uint32 lastMask = (clipped && (src.cx&0x1F)) ? (uint32(1)<<(src.cx&0x1F))-1 : 0xFFFFFFFF;
+    SILT::parallelFor(dst.cz,[&](const size_t z0, const size_t z1, const int)
+    {
+      for (size_t z=z0;z<z1;z++)
+        for (int y=0;y<int(dst.cy);y++)
+        {
+          uint32 *d = dst.raw32() + (z*dst.cy+y)*dstStride;
+          std::fill(d,d+dstUsed,fill);
+          d[dstUsed-1] &= dstLastMask;
+          if ((int(z)<box.z0)||(int(z)>=box.z1)||(y<box.y0)||(y>=box.y1)) continue;
+          const uint32 *s = src.craw32() + ((z-box.z0)*src.cy+y-box.y0)*srcStride;
+          uint32 *b = d + box.x0/32;
+          std::copy(s,s+used-1,b);
+          b[used-1] = (s[used-1]&lastMask) | (b[used-1]&~lastMask);
+        }
+    });
+    return true;
+  }
+};
+
+#endif
@@ -24,61 +24,66 @@
 
 #include <vol3d.h>
 #include <vbit.h>
+#include <vbit64.h>
+#include <DS/structuringelement.h>
+#include <algorithm>
+#include <vector>
 
+//! \brief Binary morphology on bit-packed volumes (Vol3D<VBit> or Vol3D<VBit64>).
+//! \details The C operators use the 3x3x3 cube, the R operators use the 6-neighbor cross, the B
+//!          operators use the 18-neighbor ball, and the S operators use the in-plane 3x3 square. The
+//!          kernels for each element are generated from its StructuringElement description at compile
+//!          time; a new element needs only an Operator pair and a case in SlabPipeline::kernel. All
+//!          operators can run in place; each thread streams through a z-slab keeping only a few
+//!          slices of scratch space, so no copy of the volume is made. A chain of operators passed to
+//!          apply() is fused into a single sweep.
 class Morph32 {
 public:
-  void load(std::vector<uint32> &a, Vol3D<VBit> &v)
-  {
-    const auto ds = v.size();
-    for (size_t i=0;i<ds;i++) a[i] = v[i].data;
-  }
-  Morph32() : cx(0), cy(0), cz(0), slicesize(0)
+  Morph32() : cx(0), cy(0), cz(0), slicesize(0), lineWords(0), paddedLines(false), nThreads(0)
   {
   }
   ~Morph32() {}
   void releaseMemory();
-  void init(int cx_, int cy_, int cz_);
+  void init(int cx_, int cy_, int cz_, const size_t lineWords_=0); // lineWords_ > 0 selects padded lines of that many words
+  void setThreads(const int n) { nThreads = (n>0) ? n : 0; } // 0 uses SILT::ThreadControl::nThreads()
   void setup(Vol3D<VBit> &v)
   {
-    if ((v.cx!=cx)||(v.cy!=cy)||(v.cz!=cz))
+    if ((v.cx!=cx)||(v.cy!=cy)||(v.cz!=cz)||paddedLines)
       init(v.cx,v.cy,v.cz);
   }
-  bool erodeR(Vol3D<VBit> &v)
-  {
-    setup(v);
-    load(volA,v);
-    return erodeR(&volA[0],v.raw32());
-  }
-  bool dilateR(Vol3D<VBit> &v)
-  {
-    setup(v);
-    load(volA,v);
-    return dilateR(&volA[0],v.raw32());
-  }
-  bool erodeC(Vol3D<VBit> &v)
-  {
-    setup(v);
-    load(volA,v);
-    return erodeC(&volA[0],v.raw32());
-  }
-  bool dilateC(Vol3D<VBit> &v)
-  {
-    setup(v);
-    load(volA,v);
-    return dilateC(&volA[0],v.raw32());
-  }
-  bool erodeO2(Vol3D<VBit> &v)
-  {
-    setup(v);
-    return erodeO2(v.raw32());
-  }
-  bool dilateO2(Vol3D<VBit> &v)
+  void setup(Vol3D<VBit64> &v) // padded lines are processed as 32-bit words; see vbit64.h
   {
-    setup(v);
-    return dilateO2(v.raw32());
+    if ((v.cx!=cx)||(v.cy!=cy)||(v.cz!=cz)||!paddedLines)
+      init(v.cx,v.cy,v.cz,2*wordsPerLine64(v.cx));
   }
+  //! structuring elements: C is the 3x3x3 cube, R is the 6-neighbor cross, B is the 18-neighbor ball,
+  //! and S is the 3x3 square in the xy plane
+  enum Operator { ErodeC, ErodeR, DilateC, DilateR, ErodeB, DilateB, ErodeS, DilateS };
+  static bool isCube(const Operator op) { return (op==ErodeC)||(op==DilateC); }
+  static bool isDilation(const Operator op) { return (op==DilateC)||(op==DilateR)||(op==DilateB)||(op==DilateS); }
+  //! applies ops in order, in one streaming sweep; in and out may be the same buffer
+  bool apply(const std::vector<Operator> &ops, const uint32 *in, uint32 *out);
+  template <class Bits> bool apply(const std::vector<Operator> &ops, Vol3D<Bits> &v) { setup(v); return apply(ops,v.raw32(),v.raw32()); }
+  template <class Bits> bool erodeR(Vol3D<Bits> &v) { return apply({ErodeR},v); }
+  template <class Bits> bool dilateR(Vol3D<Bits> &v) { return apply({DilateR},v); }
+  template <class Bits> bool erodeC(Vol3D<Bits> &v) { return apply({ErodeC},v); }
+  template <class Bits> bool dilateC(Vol3D<Bits> &v) { return apply({DilateC},v); }
+  template <class Bits> bool erodeB(Vol3D<Bits> &v) { return apply({ErodeB},v); }
+  template <class Bits> bool dilateB(Vol3D<Bits> &v) { return apply({DilateB},v); }
+  template <class Bits> bool erodeS(Vol3D<Bits> &v) { return apply({ErodeS},v); }
+  template <class Bits> bool dilateS(Vol3D<Bits> &v) { return apply({DilateS},v); }
+  template <class Bits> bool erodeO2(Vol3D<Bits> &v) { return apply({ErodeR,ErodeR,ErodeC,ErodeC},v); }
+  template <class Bits> bool dilateO2(Vol3D<Bits> &v) { return apply({DilateR,DilateR,DilateC,DilateC},v); }
+  // composite operators, each applied in a single sweep
+  template <class Bits> bool erodeCR(Vol3D<Bits> &v) { return apply({ErodeC,ErodeR},v); }   // erosion by C then R
+  template <class Bits> bool dilateCR(Vol3D<Bits> &v) { return apply({DilateC,DilateR},v); } // dilation by C then R
+  template <class Bits> bool closeCR(Vol3D<Bits> &v) { return apply({DilateC,DilateR,ErodeC,ErodeR},v); }
+  template <class Bits> bool openCR(Vol3D<Bits> &v) { return apply({ErodeC,ErodeR,DilateC,DilateR},v); }
+  template <class Bits> bool openO2(Vol3D<Bits> &v) { return apply({ErodeR,ErodeR,ErodeC,ErodeC,DilateR,DilateR,DilateC,DilateC},v); }
+  template <class Bits> bool closeO2(Vol3D<Bits> &v) { return apply({DilateR,DilateR,DilateC,DilateC,ErodeR,ErodeR,ErodeC,ErodeC},v); }
   bool dilateO2(uint32 *a) { return dilateO2(a,a); }
   bool erodeO2(uint32 *a) { return erodeO2(a,a); }
+  // a and b may be the same buffer
   bool dilateO2(uint32 *a, uint32 *b);
   bool erodeO2(uint32 *a, uint32 *b);
   bool dilateC(uint32 *a, uint32 *b);
@@ -92,9 +97,24 @@ public:
   void dilateY32(uint32 *in, uint32 *inB, uint32 *out, const int cx, const int cy, const int cz);
   void erodeY32(uint32 *in, uint32 *inB, uint32 *out, const int cx, const int cy, const int cz);
 protected:
+// Slices are processed in contiguous z-slabs, one per thread. For a chain of depth operators, each slab
+// has slabSlices(depth) slices of scratch space: one for each distinct row pattern of the X pass, four
+// per operator (a three-slice ring and an output slice), and the first and last depth input slices of
+// the slab.
+  struct SlabPipeline;
+  static constexpr int tempSlices = 3;
+  static size_t slabSlices(const int depth) { return tempSlices + 6*size_t(depth); }
+  int threadCount() const;
+  size_t minSlabSize(const int depth) const { return std::max<size_t>(depth,1 + (1<<16)/(slicesize+1)); } // keeps small volumes on one thread
+  uint32 *scratchSlice(const int slab, const int depth, const int n) { return &scratch[(slabSlices(depth)*slab+n)*slicesize]; }
+  void saveSlabEdges(const uint32 *in, const int nt, const int depth);
+  void clearPadding(uint32 *slice);
   uint32 cx,cy,cz;
   size_t slicesize;
-  std::vector<uint32> sliceA,volA,volB;
+  size_t lineWords; // 32-bit words per stored scanline
+  bool paddedLines; // true for the VBit64 layout, whose bits beyond cx are kept at 0
+  int nThreads;
+  std::vector<uint32> scratch;
 };
 
 #endif
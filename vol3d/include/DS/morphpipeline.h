@@ -0,0 +1,82 @@
+// Copyright (C) 2025 The Regents of the University of California
+//
+// Created by David W. Shattuck, Ph.D.
+//
+// This file is part of maskbackgroundnoise.
+//
+// maskbackgroundnoise is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, version 2.1.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+
+#ifndef MorphPipeline_H
+#define MorphPipeline_H
+
+#include <DS/morph32.h>
+#include <DS/runlengthsegmenter.h>
+#include <DS/maskcrop.h>
+#include <string>
+#include <vector>
+
+//! \brief Runs a mask recipe: a comma-separated sequence of morphology and segmentation operations.
+//! \details Recognized operations:
+//!            eC, dC    erode / dilate with the 3x3x3 cube
+//!            eR, dR    erode / dilate with the 6-neighbor cross
+//!            eB, dB    erode / dilate with the 18-neighbor ball
+//!            eS, dS    erode / dilate with the 3x3 square in the xy plane
+//!            eO2, dO2  erode / dilate with the radius 2 element (R,R,C,C)
+//!            fg        keep the largest foreground component
+//!            bg        fill the background components not connected to the largest background component
+//!            fill      fill the background components not connected to a face of the volume
+//!          The plan fuses each run of adjacent morphology operations into a single streaming sweep and
+//!          drops segmentations that immediately repeat. The Morph32 and RunLengthSegmenter objects, and
+//!          their scratch buffers, are shared by all steps.
+//!          By default the steps run on the bounding box of the foreground, grown by one voxel more than
+//!          the number of remaining dilations so the foreground never reaches the edges of the crop,
+//!          and the result is pasted back. The segmenter is told where the crop lies, so the results
+//!          match those for the full volume.
+class MorphPipeline {
+public:
+  static constexpr const char *defaultRecipe = "eC,eR,fg,dC,dR,dC,dR,eC,eR,bg";
+  enum StepType { Morphology, SegmentFG, SegmentBG, FillHoles };
+  struct Step {
+    Step(StepType type, std::string label) : type(type), label(label) {}
+    StepType type;
+    std::vector<Morph32::Operator> ops; // for Morphology steps
+    std::string label;
+  };
+  enum SeedMode { NoSeed, CenterSeed, PointSeed };
+  MorphPipeline() : verbose(false), cropToForeground(true), seedMode(NoSeed), seedX(0), seedY(0), seedZ(0) {}
+  bool parse(const std::string &recipe); // builds and plans the steps; prints an error and returns false if the recipe is invalid
+  std::string describe() const;          // the planned steps, one fused sweep per bracketed group
+  bool run(Vol3D<VBit> &v);
+  bool run(Vol3D<VBit64> &v);
+  const std::vector<Step> &steps() const { return plan; }
+  int cropMargin(const size_t first) const; // margin around the foreground bounding box before step first
+  bool verbose; // reports the time taken by each step
+  bool cropToForeground;
+  //! With a seed, fg grows only the component that contains the seed voxel, which is the center of
+  //! the volume or (seedX,seedY,seedZ). If the seed is background, all components are labeled.
+  SeedMode seedMode;
+  int seedX, seedY, seedZ; // for PointSeed
+private:
+  template <class Bits> bool runT(Vol3D<Bits> &v);
+  template <class Bits> bool runStep(const Step &step, Vol3D<Bits> &v);
+  template <class Bits> bool segmentFromSeed(Vol3D<Bits> &v) { return rls.segmentFGFromSeed(v,seed[0],seed[1],seed[2])>0; }
+  static size_t maxFusedDepth(const size_t cz, const int nThreads);
+  std::vector<Step> plan;
+  Morph32 morph;
+  RunLengthSegmenter rls;
+  int seed[3]; // seed voxel of the current run
+};
+
+#endif
@@ -0,0 +1,48 @@
+// Copyright (C) 2025 The Regents of the University of California
+//
+// Created by David W. Shattuck, Ph.D.
+//
+// This file is part of maskbackgroundnoise.
+//
+// maskbackgroundnoise is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, version 2.1.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+
+#ifndef SILT_OverlappedReader_H
+#define SILT_OverlappedReader_H
+
+#include <zstream.h>
+#include <functional>
+
+namespace SILT {
+
+//! \brief Reads a stream into memory while worker threads process the chunks that have already arrived.
+//! \details The calling thread decompresses the stream into its final location, one chunk at a time,
+//!          and publishes each completed chunk; the worker threads claim published chunks in order and
+//!          call process(first,last,worker) on byte ranges that hold whole elements, so per-chunk work
+//!          such as byte swapping, rescaling or histogramming is hidden behind the inflate. worker is in
+//!          [0,nWorkers()) and can be used to index per-thread state.
+class OverlappedReader {
+public:
+  typedef std::function<void(const size_t first, const size_t last, const int worker)> ChunkFn;
+  static const size_t defaultChunkSize = 4<<20;
+  //! reads up to len bytes into dst and returns the number of bytes read
+  size_t read(izstream &ifile, char *dst, const size_t len, const size_t elementSize, const ChunkFn &process) const;
+  int nWorkers() const; // threads that run process
+  size_t chunkSize=defaultChunkSize;
+  int nThreads=0; // 0 uses SILT::ThreadControl::nThreads(); one thread reads and the others process
+};
+
+} // end of namespace SILT
+
+#endif
@@ -0,0 +1,75 @@
+// Copyright (C) 2025 The Regents of the University of California
+//
+// Created by David W. Shattuck, Ph.D.
+//
+// This file is part of maskbackgroundnoise.
+//
+// maskbackgroundnoise is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, version 2.1.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+
+#ifndef ParallelFor_H
+#define ParallelFor_H
+
+#include <thread>
+#include <vector>
+#include <cstddef>
+
+namespace SILT {
+
+//! \brief Process-wide setting for the number of worker threads used by the vol3d kernels.
+//! \details A value of zero (the default) uses all hardware threads.
+class ThreadControl {
+public:
+  static int nThreads() { return (count()>0) ? count() : defaultThreads(); }
+  static void setThreads(const int n) { count() = (n>0) ? n : 0; }
+  static int defaultThreads()
+  {
+    const int n = static_cast<int>(std::thread::hardware_concurrency());
+    return (n>0) ? n : 1;
+  }
+private:
+  static int &count() { static int n=0; return n; }
+};
+
+//! \brief Splits the range [0,n) into contiguous blocks and processes each block on its own thread.
+//! \details f(begin,end,blockID) is called once per block; blockID is in [0,nBlocks) and can be used
+//!          to index per-thread scratch space. Blocks contain at least minBlockSize items. The first
+//!          block runs on the calling thread. Returns the number of blocks used.
+template <class F>
+int parallelFor(const size_t n, F &&f, const size_t minBlockSize=1, int nThreads=0)
+{
+  if (nThreads<=0) nThreads = ThreadControl::nThreads();
+  const size_t minBlock = (minBlockSize>0) ? minBlockSize : 1;
+  size_t nBlocks = n / minBlock;
+  if (nBlocks>size_t(nThreads)) nBlocks = nThreads;
+  if (nBlocks<=1)
+  {
+    if (n>0) f(size_t(0),n,0);
+    return 1;
+  }
+  const size_t blockSize = n / nBlocks;
+  const size_t remainder = n % nBlocks;
+  auto blockStart = [&](const size_t b) { return b*blockSize + ((b<remainder) ? b : remainder); };
+  std::vector<std::thread> threads;
+  threads.reserve(nBlocks-1);
+  for (size_t b=1;b<nBlocks;b++)
+    threads.emplace_back([&f,b,begin=blockStart(b),end=blockStart(b+1)]() { f(begin,end,static_cast<int>(b)); });
+  f(size_t(0),blockStart(1),0);
+  for (auto &t : threads) t.join();
+  return static_cast<int>(nBlocks);
+}
+
+} // end of namespace SILT
+
+#endif
@@ -24,13 +24,21 @@
 
 #include <vol3ddatatypes.h>
 
+//! \brief Statistics of a connected component, in the coordinates of the volume (or of the frame, see
+//!        RunLengthSegmenter::setFrame).
 class RegionInfo {
 public:
-  RegionInfo() : label(0), count(0), selected(0), cx(0), cy(0), cz(0)  {}
+  RegionInfo() : label(0), count(0), selected(0), cx(0), cy(0), cz(0),
+    x0(0), y0(0), z0(0), x1(-1), y1(-1), z1(-1),
+    mx(0), my(0), mz(0), sxx(0), syy(0), szz(0), sxy(0), sxz(0), syz(0), touchesBorder(false) {}
   sint32 label;
-  sint32 count;
+  sint64 count;
   sint32 selected;
-  sint64 cx, cy, cz; // centroid
+  sint64 cx, cy, cz; // centroid, rounded down
+  sint32 x0, y0, z0, x1, y1, z1; // bounding box, inclusive
+  double mx, my, mz; // centroid
+  double sxx, syy, szz, sxy, sxz, syz; // second central moments (covariance of the voxel coordinates)
+  bool touchesBorder; // true if the component has a voxel on a face of the volume
 };
 
 #endif
@@ -23,18 +23,74 @@
 #define RunLength_H
 
 #include <vol3ddatatypes.h>
+#include <DS/bitscan.h>
+#include <vector>
 
-class RunLength {
+//! \brief A run of voxels [start,stop] in a scanline; Coordinate sets the widest line it can describe.
+template <class Coordinate> class RunLengthT {
 public:
-  RunLength() : start(-1), stop(-1) {}
-  sint16 start;
-  sint16 stop;
-  bool intersects(const RunLength &r) const
+  RunLengthT() : start(-1), stop(-1) {}
+  RunLengthT(const Coordinate start, const Coordinate stop) : start(start), stop(stop) {}
+  Coordinate start;
+  Coordinate stop;
+  bool intersects(const RunLengthT &r) const
   { return (start<=r.stop)&&(r.start<=stop); }
-  bool neighbors(const RunLength &r) const
+  bool neighbors(const RunLengthT &r) const
   { return ((start<=(r.stop+1))&&(r.start<=(stop+1))); }
 };
 
+typedef RunLengthT<sint32> RunLength;
+
+//! Appends the runs of set bits of a line of cx bits, stored in 32-bit words, after xor-ing each word
+//! with invert. Run ends are found with bit scans, so words inside or outside a run cost one test.
+template <class Run> void appendRuns32(std::vector<Run> &runs, const uint32 *row, const int cx, const uint32 invert)
+{
+  const int usedWords = (cx+31)>>5;
+  const uint32 lastMask = (cx&0x1F) ? SILT::BitScan::through((cx&0x1F)-1) : 0xFFFFFFFF;
+  Run newRun;
+  bool inRun = false;
+  for (int w=0;w<usedWords;w++)
+  {
+    uint32 bits = row[w]^invert;
+    if (w+1==usedWords) bits &= lastMask; // ignore the padding
+    if (bits==(inRun ? 0xFFFFFFFF : 0)) continue;
+    const int base = w<<5;
+    int pos = 0;
+    while (pos<32)
+    {
+      const uint32 edges = (inRun ? ~bits : bits) & SILT::BitScan::from(pos);
+      if (!edges) break;
+      pos = SILT::BitScan::lowest(edges);
+      if (inRun)
+      {
+        newRun.stop = base + pos - 1;
+        runs.push_back(newRun);
+      }
+      else
+        newRun.start = base + pos;
+      inRun = !inRun;
+    }
+  }
+  if (inRun)
+  {
+    newRun.stop = cx - 1;
+    runs.push_back(newRun);
+  }
+}
+
+//! Flips bits [start,stop] of a line of 32-bit words, a whole word at a time.
+inline void toggleRun32(uint32 *row, const int start, const int stop)
+{
+  const int w0 = start>>5;
+  const int w1 = stop>>5;
+  const uint32 first = SILT::BitScan::from(start&0x1F);
+  const uint32 final = SILT::BitScan::through(stop&0x1F);
+  if (w0==w1) { row[w0] ^= first & final; return; }
+  row[w0] ^= first;
+  for (int w=w0+1;w<w1;w++) row[w] ^= 0xFFFFFFFF;
+  row[w1] ^= final;
+}
+
 #endif
 
 
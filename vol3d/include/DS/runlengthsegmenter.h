@@ -24,9 +24,11 @@
 
 #include <vol3d.h>
 #include <vbit.h>
+#include <vbit64.h>
 #include <vector>
 #include <DS/runlength.h>
 #include <DS/regioninfo.h>
+#include <DS/unionfind.h>
 
 class RunLengthSegmenter {
 public:
@@ -37,10 +39,13 @@ public:
   static int intersect(RunLength& r1, RunLength& r2);
   static bool regionInfoGE(const RegionInfo &ri, const RegionInfo &ri2);
   int labelID(const int x, const int y, const int z); // find the ID of a given voxel, if it has one
-  void setup(const int cx_, const int cy_, const int cz_);
+  void setup(const int cx_, const int cy_, const int cz_, const int lineWords_=0); // lineWords_ = 0 uses wordsPerLine(cx_)
+  void setThreads(const int n) { nThreads = (n>0) ? n : 0; } // threads used for labeling; 0 uses SILT::ThreadControl::nThreads()
   void label32FG(Vol3D<VBit> &imageOut) { label32FG(imageOut.raw32()); }
   void label32BG(Vol3D<VBit> &imageOut) { label32BG(imageOut.raw32()); }
-  int regionCount(int n) const  
+  void label32FG(Vol3D<VBit64> &imageOut) { label32FG(imageOut.raw32()); } // call after segmenting a Vol3D<VBit64>
+  void label32BG(Vol3D<VBit64> &imageOut) { label32BG(imageOut.raw32()); }
+  sint64 regionCount(int n) const
   {
     if (n<nregions)
       return regionInfo[n].count;
@@ -57,17 +62,79 @@ public:
     setup(v.cx,v.cy,v.cz);
     segment32BG(v.raw32(),v.raw32());
   }
+  // padded 64-bit volumes are scanned as 32-bit words with a line stride of 2*wordsPerLine64(cx); see vbit64.h
+  int segmentFG(Vol3D<VBit64> &v)
+  {
+    setup(v.cx,v.cy,v.cz,2*wordsPerLine64(v.cx));
+    return segment32FG(v.raw32(),v.raw32());
+  }
+  void segmentBG(Vol3D<VBit64> &v)
+  {
+    setup(v.cx,v.cy,v.cz,2*wordsPerLine64(v.cx));
+    segment32BG(v.raw32(),v.raw32());
+  }
+  //! Keeps only the foreground component that contains voxel (x,y,z), grown run by run from the seed
+  //! without labeling the other components. (x,y,z) uses the coordinates of the frame, if one is set.
+  //! Returns the number of voxels kept, or 0 if the seed is background; v is then unchanged.
+  size_t segmentFGFromSeed(Vol3D<VBit> &v, const int x, const int y, const int z)
+  {
+    setup(v.cx,v.cy,v.cz);
+    return segment32FGFromSeed(v.raw32(),x,y,z);
+  }
+  size_t segmentFGFromSeed(Vol3D<VBit64> &v, const int x, const int y, const int z)
+  {
+    setup(v.cx,v.cy,v.cz,2*wordsPerLine64(v.cx));
+    return segment32FGFromSeed(v.raw32(),x,y,z);
+  }
+  //! Fills the holes of the mask: background voxels not connected to a face of the volume, or to the
+  //! outside of the frame, become foreground. The background is flooded run by run from the faces,
+  //! so the cost follows the size of the exterior background. Returns the number of voxels filled.
+  size_t fillHoles(Vol3D<VBit> &v)
+  {
+    setup(v.cx,v.cy,v.cz);
+    return fillHoles32(v.raw32());
+  }
+  size_t fillHoles(Vol3D<VBit64> &v)
+  {
+    setup(v.cx,v.cy,v.cz,2*wordsPerLine64(v.cx));
+    return fillHoles32(v.raw32());
+  }
+  //! Keeps every foreground component with more than minVoxels voxels. Returns the number kept.
+  int keepComponentsLargerThan(Vol3D<VBit> &v, const sint64 minVoxels)
+  {
+    setup(v.cx,v.cy,v.cz);
+    return keep32FG(v.raw32(),minVoxels);
+  }
+  int keepComponentsLargerThan(Vol3D<VBit64> &v, const sint64 minVoxels)
+  {
+    setup(v.cx,v.cy,v.cz,2*wordsPerLine64(v.cx));
+    return keep32FG(v.raw32(),minVoxels);
+  }
+  //! Writes the rank of each voxel's component in regionInfo (1 for the largest) to a volume the size
+  //! of the segmented one, with 0 for voxels that are not in a run; call after presegmentFG or presegmentBG.
+  bool labelVolume(Vol3D<sint32> &labels) const;
+  //! Places the segmented volume at (x0,y0,z0) in a larger volume of size frameCX x frameCY x frameCZ
+  //! whose voxels outside it are background, e.g., when segmenting a crop. Region centroids and the
+  //! centering test use the coordinates of the larger volume, and the background region that touches
+  //! the outside also counts the outside voxels. The outside must be background and connected to
+  //! the faces of the crop that are not at the border of the larger volume.
+  void setFrame(const int x0, const int y0, const int z0, const int frameCX, const int frameCY, const int frameCZ);
+  void clearFrame() { setFrame(0,0,0,0,0,0); }
+  bool outsideSelected() const; // true if the last background segmentation kept the outside voxels as background
   std::vector<RegionInfo> regionInfo; // this should be behind an access function
   int CX() const { return cx; }
   int CY() const { return cy; }
   int CZ() const { return cz; }
   int presegmentBG(Vol3D<VBit> &v);
   int presegmentFG(Vol3D<VBit> &v);
+  int presegmentBG(Vol3D<VBit64> &v);
+  int presegmentFG(Vol3D<VBit64> &v);
 
   Mode mode;
   int cx;				// Image dimensions
   int cy;
   int cz;
+  int lineWords; // 32-bit words per stored scanline of the bit images
 protected:
   void remap(std::vector<LabelType> &newMap);
   int segmenttest32FG(uint8 *imageIn, uint32 *imageOut);
@@ -76,25 +143,44 @@ protected:
   void label32FG(uint32 *imageOut);
   void label32BG(uint32 *imageOut);
 protected:
+  struct RegionSums { // coordinate sums of a region, in the coordinates of the segmented volume
+    RegionSums() : x(0), y(0), z(0), xx(0), yy(0), zz(0), xy(0), xz(0), yz(0) {}
+    sint64 x, y, z;
+    double xx, yy, zz, xy, xz, yz;
+  };
+  void addRun(RegionInfo &r, RegionSums &s, const int run, const int y, const int z) const;
+  void finishRegion(RegionInfo &r, const RegionSums &s) const;
+  int keep32FG(uint32 *image, const sint64 minVoxels);
   void population();
+  void addOutside(RegionInfo *ri, RegionSums *sums);
   int findRegion(const int cx, const int cy, const int cz);
+  int findRun(const int line, const int x) const; // the run of the line that contains x, or -1
+  int firstRunReaching(const int line, const int x) const; // the first run of the line with stop>=x
+  template <class F> void forEachAdjacentRun(const int run, const int line, F &&f) const;
+  size_t segment32FGFromSeed(uint32 *image, const int x, const int y, const int z);
+  size_t fillHoles32(uint32 *image);
+  void setAll32(uint32 *imageOut); // sets the voxels of each line and clears the padding
   void findmax();
   void makeGraph();
-  void makeGraph6();
-  void makeGraph26();
-  void makeGraph18();
+  template <class Sets> void linkLines(Sets &sets, const int a, const int b, const bool diagonal);
+  template <class Sets> void linkPreviousSlice(Sets &sets, const int line);
+  template <class Sets> void linkSlab(Sets &sets, const int z0, const int z1, const bool linkFirst);
   void label(uint8  *buffOut);
   void encode(uint8  *buffer);
   void encode32FG(uint32 *imageIn);
   void encode32BG(uint32 *imageIn);
+  void encode32(const uint32 *imageIn, const uint32 invert);
+  void toggleSelectedRuns(uint32 *imageOut);
   void segment32FG(uint8 *imageIn, uint32 *imageOut);
   int  segment32FG(uint32 *imageIn, uint32 *imageOut);
   void segment32BG(uint8 *imageIn, uint32 *imageOut);
   void segment32BG(uint32 *imageIn, uint32 *imageOut);
 
-  std::vector<RunLength> runs;
+  std::vector<RunLength> runs; // sized by the encoders to the number of runs, not the number of voxels
   std::vector<int> linestart; // start of an x scan-line
   std::vector<LabelType> map,newmap;
+  UnionFind sets; // runs that touch are merged while scanning; map holds the resulting labels
+  ConcurrentUnionFind concurrentSets; // used instead of sets when labeling with several threads
 
   int nregions;
   uint8 high;
@@ -103,8 +189,13 @@ protected:
   int runcount;
   int nsymbols;
   bool verbose;
+  int nThreads;
   int NMax;
   int rlsPicked;
+  bool background; // true if the runs encode the background voxels
+  int frameX0, frameY0, frameZ0; // see setFrame
+  int frameCX, frameCY, frameCZ; // 0 if there is no frame
+  int outsideRegion; // label of the region that contains the outside voxels, or -1
 public:
   bool ensureCentered;
 };
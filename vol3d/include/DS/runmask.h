@@ -0,0 +1,126 @@
+// Copyright (C) 2025 The Regents of the University of California
+//
+// Created by David W. Shattuck, Ph.D.
+//
+// This file is part of maskbackgroundnoise.
+//
+// maskbackgroundnoise is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, version 2.1.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+
+
+#ifndef RunMask_H
+#define RunMask_H
+
+#include <vol3d.h>
+#include <vbit.h>
+#include <vbit64.h>
+#include <DS/runlength.h>
+#include <DS/morph32.h>
+#include <DS/parallelfor.h>
+#include <vector>
+
+//! \brief A binary mask stored as the sorted, disjoint runs of each scanline.
+//! \details Memory and the cost of the morphology operators follow the number of runs, i.e., the
+//!          complexity of the mask's boundary, rather than the number of voxels, so a sparse mask of
+//!          a very large volume can be thresholded, filtered and only then decoded to bits. Each output
+//!          line of an erosion or dilation is computed from the runs of the neighboring input lines:
+//!          dilation is the union of the runs shifted and widened by the rows of the structuring
+//!          element, and erosion is the intersection of the narrowed runs. Voxels outside the volume
+//!          are background, so the results match Morph32 on Vol3D<VBit64>; on Vol3D<VBit>, Morph32 also
+//!          sees the bits a dilation leaves in the padding past cx. Lines are processed in parallel.
+class RunMask {
+public:
+  RunMask() : cx(0), cy(0), cz(0), nThreads(0) {}
+  void setThreads(const int n) { nThreads = (n>0) ? n : 0; } // 0 uses SILT::ThreadControl::nThreads()
+  //! encodes the voxels of v for which inMask(voxel) is true
+  template <class T, class Pred> bool encodeIf(const Vol3D<T> &v, Pred inMask);
+  bool encode(const Vol3D<VBit> &v) { return encode32(int(v.cx),int(v.cy),int(v.cz),v.craw32(),wordsPerLine(v.cx)); }
+  bool encode(const Vol3D<VBit64> &v) { return encode32(int(v.cx),int(v.cy),int(v.cz),v.craw32(),2*wordsPerLine64(v.cx)); }
+  bool decode(Vol3D<VBit> &v) const;
+  bool decode(Vol3D<VBit64> &v) const;
+  //! applies the Morph32 operators in order
+  bool apply(const std::vector<Morph32::Operator> &ops);
+  size_t runCount() const { return runs.size(); }
+  sint64 count() const; // number of voxels in the mask
+  int cx, cy, cz;
+private:
+  typedef std::vector<RunLength> Runs;
+  struct Scratch { Runs a, b, c, d; }; // per-thread buffers for building a line
+  bool encode32(const int cx_, const int cy_, const int cz_, const uint32 *words, const size_t lineWords);
+  void decode32(uint32 *words, const size_t lineWords) const;
+  //! replaces the runs with those produced by makeLine(out,line,scratch), which appends the runs of a line
+  template <class LineFn> void buildLines(LineFn makeLine);
+  template <unsigned int element, bool dilate> void morph();
+  template <unsigned int element> void dilateLine(Runs &out, const int y, const int z, Scratch &scratch) const;
+  template <unsigned int element> void erodeLine(Runs &out, const int y, const int z, Scratch &scratch) const;
+  Runs runs;
+  std::vector<size_t> linestart; // runs of line l are [linestart[l],linestart[l+1])
+  int nThreads;
+};
+
+template <class LineFn> void RunMask::buildLines(LineFn makeLine)
+{
+  const size_t nLines = size_t(cy)*cz;
+  const int nt = (nThreads>0) ? nThreads : SILT::ThreadControl::nThreads();
+  std::vector<Runs> parts(nt);
+  std::vector<size_t> blockStart(nt+1,nLines);
+  std::vector<size_t> newStart(nLines+1,0);
+  const int nBlocks = SILT::parallelFor(nLines,[&](const size_t first, const size_t last, const int block)
+  {
+    Scratch scratch;
+    blockStart[block] = first;
+    for (size_t line=first;line<last;line++)
+    {
+      newStart[line] = parts[block].size();
+      makeLine(parts[block],line,scratch);
+    }
+  },256,nt);
+  size_t total = 0;
+  for (int b=0;b<nBlocks;b++) total += parts[b].size();
+  Runs newRuns;
+  newRuns.reserve(total);
+  for (int b=0;b<nBlocks;b++)
+  {
+    const size_t offset = newRuns.size();
+    for (size_t line=blockStart[b];line<blockStart[b+1];line++) newStart[line] += offset;
+    newRuns.insert(newRuns.end(),parts[b].begin(),parts[b].end());
+  }
+  newStart[nLines] = newRuns.size();
+  runs.swap(newRuns);
+  linestart.swap(newStart);
+}
+
+template <class T, class Pred> bool RunMask::encodeIf(const Vol3D<T> &v, Pred inMask)
+{
+  cx = int(v.cx);
+  cy = int(v.cy);
+  cz = int(v.cz);
+  const T *data = v.start();
+  buildLines([&](Runs &out, const size_t line, Scratch &)
+  {
+    const T *p = data + line*cx;
+    int x = 0;
+    while (x<cx)
+    {
+      while ((x<cx)&&!inMask(p[x])) x++;
+      if (x==cx) break;
+      const int start = x;
+      while ((x<cx)&&inMask(p[x])) x++;
+      out.push_back(RunLength(start,x-1));
+    }
+  });
+  return true;
+}
+
+#endif
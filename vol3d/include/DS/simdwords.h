@@ -0,0 +1,125 @@
+// Copyright (C) 2025 The Regents of the University of California
+//
+// Created by David W. Shattuck, Ph.D.
+//
+// This file is part of maskbackgroundnoise.
+//
+// maskbackgroundnoise is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, version 2.1.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+
+#ifndef SIMDWords_H
+#define SIMDWords_H
+
+#include <cstddef>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+namespace SILT {
+
+//! \brief Vectors of 32-bit words for the bitwise kernels, using the widest instruction set enabled at compile time.
+//! \details AVX-512 and AVX2 are used when the compiler targets them (e.g., -march=native or /arch:AVX2);
+//!          x86-64 builds otherwise use SSE2. Other targets use single words, which the compiler may vectorize.
+struct SIMDWords {
+  typedef unsigned int uint32;
+#if defined(__AVX512F__)
+  typedef __m512i V;
+  static constexpr size_t width = 16;
+  static V load(const uint32 *p) { return _mm512_loadu_si512(p); }
+  static void store(uint32 *p, const V v) { _mm512_storeu_si512(p,v); }
+  static V zero() { return _mm512_setzero_si512(); }
+  static V orv(const V a, const V b) { return _mm512_or_si512(a,b); }
+  static V andv(const V a, const V b) { return _mm512_and_si512(a,b); }
+  static V andnotv(const V a, const V b) { return _mm512_andnot_si512(b,a); }
+  template <int n> static V shl(const V a) { return _mm512_slli_epi32(a,n); }
+  template <int n> static V shr(const V a) { return _mm512_srli_epi32(a,n); }
+#elif defined(__AVX2__)
+  typedef __m256i V;
+  static constexpr size_t width = 8;
+  static V load(const uint32 *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+  static void store(uint32 *p, const V v) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p),v); }
+  static V zero() { return _mm256_setzero_si256(); }
+  static V orv(const V a, const V b) { return _mm256_or_si256(a,b); }
+  static V andv(const V a, const V b) { return _mm256_and_si256(a,b); }
+  static V andnotv(const V a, const V b) { return _mm256_andnot_si256(b,a); }
+  template <int n> static V shl(const V a) { return _mm256_slli_epi32(a,n); }
+  template <int n> static V shr(const V a) { return _mm256_srli_epi32(a,n); }
+#elif defined(__SSE2__) || defined(_M_X64)
+  typedef __m128i V;
+  static constexpr size_t width = 4;
+  static V load(const uint32 *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+  static void store(uint32 *p, const V v) { _mm_storeu_si128(reinterpret_cast<__m128i *>(p),v); }
+  static V zero() { return _mm_setzero_si128(); }
+  static V orv(const V a, const V b) { return _mm_or_si128(a,b); }
+  static V andv(const V a, const V b) { return _mm_and_si128(a,b); }
+  static V andnotv(const V a, const V b) { return _mm_andnot_si128(b,a); }
+  template <int n> static V shl(const V a) { return _mm_slli_epi32(a,n); }
+  template <int n> static V shr(const V a) { return _mm_srli_epi32(a,n); }
+#else
+  typedef uint32 V;
+  static constexpr size_t width = 1;
+  static V load(const uint32 *p) { return *p; }
+  static void store(uint32 *p, const V v) { *p = v; }
+  static V zero() { return 0; }
+  static V orv(const V a, const V b) { return a | b; }
+  static V andv(const V a, const V b) { return a & b; }
+  static V andnotv(const V a, const V b) { return a & ~b; }
+  template <int n> static V shl(const V a) { return a<<n; }
+  template <int n> static V shr(const V a) { return a>>n; }
+#endif
+  //! Bitwise operators usable on both vectors and single words; selected by the kernels' template arguments.
+  struct Or {
+    static V apply(const V a, const V b) { return orv(a,b); }
+    static uint32 apply1(const uint32 a, const uint32 b) { return a | b; }
+  };
+  struct And {
+    static V apply(const V a, const V b) { return andv(a,b); }
+    static uint32 apply1(const uint32 a, const uint32 b) { return a & b; }
+  };
+  struct AndNot { // a & ~b
+    static V apply(const V a, const V b) { return andnotv(a,b); }
+    static uint32 apply1(const uint32 a, const uint32 b) { return a & ~b; }
+  };
+  //! out[i] = a[i] op b[i]; out may be a or b.
+  template <class Op> static void combine(uint32 *out, const uint32 *a, const uint32 *b, const size_t n)
+  {
+    size_t i=0;
+    for (;i+width<=n;i+=width) store(out+i,Op::apply(load(a+i),load(b+i)));
+    for (;i<n;i++) out[i] = Op::apply1(a[i],b[i]);
+  }
+  //! out[i] = a[i] op rest[0][i] op rest[1][i] ..., for any number of inputs; out may be any of the inputs.
+  template <class Op, class... P> static void combineAll(uint32 *out, const size_t n, const uint32 *a, const P *... rest)
+  {
+    size_t i=0;
+    for (;i+width<=n;i+=width)
+    {
+      V v = load(a+i);
+      ((v = Op::apply(v,load(rest+i))), ...);
+      store(out+i,v);
+    }
+    for (;i<n;i++)
+    {
+      uint32 v = a[i];
+      ((v = Op::apply1(v,rest[i])), ...);
+      out[i] = v;
+    }
+  }
+};
+
+} // end of namespace SILT
+
+#endif
@@ -0,0 +1,83 @@
+// Copyright (C) 2025 The Regents of the University of California
+//
+// Created by David W. Shattuck, Ph.D.
+//
+// This file is part of maskbackgroundnoise.
+//
+// maskbackgroundnoise is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, version 2.1.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+
+
+#ifndef StructuringElement_H
+#define StructuringElement_H
+
+//! \brief A 3x3x3 structuring element described at compile time.
+//! \details Bit (dz+1)*9 + (dy+1)*3 + (dx+1) of the mask selects the offset (dx,dy,dz). Morph32 builds
+//!          its kernels from the rows and planes of the element: each row is a pattern of x shifts,
+//!          each plane combines up to three rows, and each output slice combines up to three planes.
+//!          All of these are template arguments, so the kernels are fully unrolled for each element.
+template <unsigned int bits> class StructuringElement {
+public:
+  typedef unsigned int uint32;
+  static constexpr uint32 mask = bits & 0x7FFFFFF;
+  static constexpr uint32 bit(const int dx, const int dy, const int dz) { return uint32(1)<<((dz+1)*9+(dy+1)*3+(dx+1)); }
+  static constexpr bool has(const int dx, const int dy, const int dz) { return (mask & bit(dx,dy,dz))!=0; }
+  //! x pattern of row dy of plane dz; bits 0, 1 and 2 select dx = -1, 0 and 1
+  static constexpr uint32 row(const int dy, const int dz) { return (mask>>((dz+1)*9+(dy+1)*3)) & 0x7; }
+  //! rows of plane dz, as a 9-bit mask of three row patterns
+  static constexpr uint32 plane(const int dz) { return (mask>>((dz+1)*9)) & 0x1FF; }
+  //! bits 0, 1 and 2 select the nonempty planes dz = -1, 0 and 1
+  static constexpr uint32 planes() { return (plane(-1) ? 1 : 0) | (plane(0) ? 2 : 0) | (plane(1) ? 4 : 0); }
+  //! the first nonempty plane
+  static constexpr uint32 commonPlane() { return plane(0) ? plane(0) : plane(-1) ? plane(-1) : plane(1); }
+  //! true if every nonempty plane is the same, so the element is an in-plane filter followed by a z filter
+  static constexpr bool zSeparable()
+  {
+    const uint32 p = commonPlane();
+    return (!plane(-1) || plane(-1)==p) && (!plane(0) || plane(0)==p) && (!plane(1) || plane(1)==p);
+  }
+  //! the element reflected through the origin; dilation by an element uses its reflection
+  static constexpr uint32 reflected()
+  {
+    uint32 r = 0;
+    for (int i=0;i<27;i++) if (mask & (uint32(1)<<i)) r |= uint32(1)<<(26-i);
+    return r;
+  }
+  static_assert(mask!=0,"a structuring element must have at least one offset");
+};
+
+//! builds a structuring element mask from a predicate on the offsets (dx,dy,dz), each in [-1,1]
+template <class Predicate> constexpr unsigned int structuringElementMask(Predicate inElement)
+{
+  unsigned int m = 0;
+  for (int dz=-1;dz<=1;dz++)
+    for (int dy=-1;dy<=1;dy++)
+      for (int dx=-1;dx<=1;dx++)
+        if (inElement(dx,dy,dz)) m |= 1u<<((dz+1)*9+(dy+1)*3+(dx+1));
+  return m;
+}
+
+namespace StructuringElements {
+constexpr int offsetCount(const int dx, const int dy, const int dz) { return (dx!=0)+(dy!=0)+(dz!=0); }
+constexpr unsigned int cubeMask = structuringElementMask([](int, int, int) { return true; });
+constexpr unsigned int crossMask = structuringElementMask([](int dx, int dy, int dz) { return offsetCount(dx,dy,dz)<=1; });
+constexpr unsigned int ballMask = structuringElementMask([](int dx, int dy, int dz) { return offsetCount(dx,dy,dz)<=2; });
+constexpr unsigned int squareMask = structuringElementMask([](int, int, int dz) { return dz==0; });
+typedef StructuringElement<cubeMask> Cube;     // 3x3x3 cube (26-neighborhood)
+typedef StructuringElement<crossMask> Cross;   // 6-neighbor cross
+typedef StructuringElement<ballMask> Ball;     // small ball: the 18-neighborhood, i.e., the cube without its corners
+typedef StructuringElement<squareMask> Square; // 3x3 square in the xy plane (in-plane 8-neighborhood)
+}
+
+#endif
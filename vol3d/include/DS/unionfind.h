@@ -0,0 +1,131 @@
+// Copyright (C) 2025 The Regents of the University of California
+//
+// Created by David W. Shattuck, Ph.D.
+//
+// This file is part of maskbackgroundnoise.
+//
+// maskbackgroundnoise is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, version 2.1.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+
+
+#ifndef UnionFind_H
+#define UnionFind_H
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <atomic>
+#include <memory>
+
+//! \brief Disjoint sets over the integers [0,n), with union by rank and path compression.
+class UnionFind {
+public:
+  void reset(const int n)
+  {
+    parent.resize(n);
+    rank.assign(n,0);
+    for (int i=0;i<n;i++) parent[i] = i;
+  }
+  int find(int a)
+  {
+    while (parent[a]!=a)
+    {
+      parent[a] = parent[parent[a]]; // path halving
+      a = parent[a];
+    }
+    return a;
+  }
+  void unite(int a, int b)
+  {
+    a = find(a);
+    b = find(b);
+    if (a==b) return;
+    if (rank[a]<rank[b]) std::swap(a,b);
+    parent[b] = a;
+    if (rank[a]==rank[b]) rank[a]++;
+  }
+  //! labels the sets 1, 2, ... in order of their smallest member; returns the number of sets
+  int makemap(int *map)
+  {
+    const int n = int(parent.size());
+    int nLabels = 0;
+    for (int i=0;i<n;i++) map[i] = 0;
+    for (int i=0;i<n;i++) // map[root] holds the label of a set until i reaches it
+    {
+      const int root = find(i);
+      if (map[root]==0) map[root] = ++nLabels;
+      map[i] = map[root];
+    }
+    return nLabels;
+  }
+private:
+  std::vector<int> parent;
+  std::vector<uint8_t> rank;
+};
+
+//! \brief Disjoint sets that several threads can merge at once without locks.
+//! \details A root is linked below a smaller root with compare-and-swap, and find() shortens paths
+//!          as it goes. Since sets are numbered by their smallest member, makemap() gives the same
+//!          labels as UnionFind for the same merges, in any order.
+class ConcurrentUnionFind {
+public:
+  ConcurrentUnionFind() : n(0) {}
+  void reset(const int n_)
+  {
+    if (n_>n || !parent) parent.reset(new std::atomic<int>[n_]);
+    n = n_;
+    for (int i=0;i<n;i++) parent[i].store(i,std::memory_order_relaxed);
+  }
+  int find(int a)
+  {
+    for (;;)
+    {
+      int p = parent[a].load(std::memory_order_relaxed);
+      if (p==a) return a;
+      const int gp = parent[p].load(std::memory_order_relaxed);
+      if (gp!=p) parent[a].compare_exchange_weak(p,gp,std::memory_order_relaxed); // path halving
+      a = gp;
+    }
+  }
+  void unite(int a, int b)
+  {
+    for (;;)
+    {
+      a = find(a);
+      b = find(b);
+      if (a==b) return;
+      if (a<b) std::swap(a,b);
+      int expected = a;
+      if (parent[a].compare_exchange_strong(expected,b,std::memory_order_acq_rel)) return;
+    }
+  }
+  //! call after all threads have finished merging; see UnionFind::makemap
+  int makemap(int *map)
+  {
+    int nLabels = 0;
+    for (int i=0;i<n;i++) map[i] = 0;
+    for (int i=0;i<n;i++)
+    {
+      const int root = find(i);
+      if (map[root]==0) map[root] = ++nLabels;
+      map[i] = map[root];
+    }
+    return nLabels;
+  }
+private:
+  std::unique_ptr<std::atomic<int>[]> parent;
+  int n;
+};
+
+#endif
@@ -0,0 +1,125 @@
+// Copyright (C) 2025 The Regents of the University of California
+//
+// Created by David W. Shattuck, Ph.D.
+//
+// This file is part of maskbackgroundnoise.
+//
+// maskbackgroundnoise is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, version 2.1.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+
+#ifndef SILT_VoxelStore_H
+#define SILT_VoxelStore_H
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace SILT {
+
+//! \brief A copy-on-write memory mapping of a byte range of a file.
+//! \details Pages are read from the page cache on first access; writes go to private copies of the
+//!          pages and never reach the file. The mapping is hinted for sequential access and, where the
+//!          platform supports it, transparent huge pages.
+class MappedFile {
+public:
+  MappedFile() {}
+  ~MappedFile() { close(); }
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  bool open(const std::string &filename, const uint64_t offset, const size_t length);
+  void close();
+  void *data() const { return address; }
+  size_t size() const { return length; }
+private:
+  void *view=nullptr;    // start of the mapped pages
+  size_t viewLength=0;
+  void *address=nullptr; // start of the requested range
+  size_t length=0;
+};
+
+//! \brief Voxel storage for Vol3D: an owned std::vector, or a view of a mapped file.
+//! \details Provides the subset of the std::vector interface that Vol3D uses. A mapped store keeps its
+//!          mapping as long as it is not resized to a different length; resizing copies the retained
+//!          voxels into owned memory, as std::vector::resize would. Copies are always owned.
+template <class T>
+class VoxelStore {
+public:
+  VoxelStore() {}
+  VoxelStore(const VoxelStore &s) { *this = s; }
+  VoxelStore &operator=(const VoxelStore &s)
+  {
+    if (this!=&s)
+    {
+      std::vector<T> copy(s.begin(),s.end());
+      owned.swap(copy);
+      mapping.reset();
+      base = owned.data();
+      n = owned.size();
+    }
+    return *this;
+  }
+  void swap(VoxelStore &s)
+  {
+    owned.swap(s.owned);
+    mapping.swap(s.mapping);
+    std::swap(base,s.base);
+    std::swap(n,s.n);
+  }
+  void resize(const size_t count)
+  {
+    if (mapping)
+    {
+      if (count==n) return;
+      std::vector<T> copy(base,base+std::min(count,n));
+      owned.swap(copy);
+      mapping.reset();
+    }
+    owned.resize(count);
+    base = owned.data();
+    n = owned.size();
+  }
+  //! replaces the contents with a view of count voxels stored at offset in filename
+  bool map(const std::string &filename, const uint64_t offset, const size_t count)
+  {
+    if ((count==0)||(offset%alignof(T))) return false;
+    auto file = std::make_unique<MappedFile>();
+    if (!file->open(filename,offset,count*sizeof(T))) return false;
+    std::vector<T>().swap(owned);
+    mapping = std::move(file);
+    base = static_cast<T *>(mapping->data());
+    n = count;
+    return true;
+  }
+  bool isMapped() const { return bool(mapping); }
+  size_t size() const { return n; }
+  T &operator[](const size_t i) { return base[i]; }
+  const T &operator[](const size_t i) const { return base[i]; }
+  T *begin() { return base; }
+  T *end() { return base+n; }
+  const T *begin() const { return base; }
+  const T *end() const { return base+n; }
+  const T *cbegin() const { return base; }
+  const T *cend() const { return base+n; }
+private:
+  std::vector<T> owned;
+  std::unique_ptr<MappedFile> mapping;
+  T *base=nullptr;
+  size_t n=0;
+};
+
+} // end of namespace SILT
+
+#endif
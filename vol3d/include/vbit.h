@@ -23,6 +23,12 @@
 
 #include <vol3d.h>
 #include <DS/codec32.h>
+#include <DS/simdwords.h>
+#include <DS/bitscan.h>
+#include <DS/parallelfor.h>
+#include <vector>
+#include <algorithm>
+#include <numeric>
 
 class VBit {
 public:
@@ -31,6 +37,42 @@ public:
   uint32 data; // place holder
 };
 
+namespace SILT {
+//! dst[i] = dst[i] op src[i] for n words, using SIMDWords and split across threads
+template <class Op> inline void combineWords(uint32 *dst, const uint32 *src, const size_t n)
+{
+  parallelFor(n,[&](const size_t i0, const size_t i1, const int)
+  {
+    SIMDWords::combine<Op>(dst+i0,dst+i0,src+i0,i1-i0);
+  },size_t(1)<<16);
+}
+
+//! number of set voxels in each slice of a bit volume with lines of stride 32-bit words, where
+//! word(i) returns word i; bits past cx in the last word of each line are ignored
+template <class Word> inline std::vector<size_t> countSliceBits(const size_t cx, const size_t cy, const size_t cz, const size_t stride, Word word)
+{
+  std::vector<size_t> counts(cz,0);
+  const size_t wpl = (cx+31)>>5;
+  if (wpl==0) return counts;
+  const uint32 lastMask = (cx&0x1F) ? BitScan::through(int(cx&0x1F)-1) : 0xFFFFFFFF;
+  parallelFor(cz,[&](const size_t z0, const size_t z1, const int)
+  {
+    for (size_t z=z0;z<z1;z++)
+    {
+      size_t n = 0;
+      for (size_t y=0;y<cy;y++)
+      {
+        const size_t base = (z*cy+y)*stride;
+        for (size_t w=0;w+1<wpl;w++) n += BitScan::count(word(base+w));
+        n += BitScan::count(word(base+wpl-1) & lastMask);
+      }
+      counts[z] = n;
+    }
+  },1 + (size_t(1)<<16)/(wpl*cy+1));
+  return counts;
+}
+} // end of namespace SILT
+
 template<> inline Vol3DBase::dim_type Vol3D<VBit>::size() const
 {
   return data.size();
@@ -51,16 +93,9 @@ template<> inline bool Vol3D<VBit>::copy(const Vol3D<VBit> &vSource)
 
 inline bool setDiff(Vol3D<VBit> &dst, Vol3D<VBit> &src)
 {
-  if (dst.isCompatible(src))
-  {
-    int ds = dst.size();
-    auto *d = dst.raw32();
-    auto *s = src.craw32();
-    for (int i=0;i<ds;i++) d[i] ^= (d[i]&s[i]);
-    return true;
-  }
-  else
-    return false;
+  if (!dst.isCompatible(src)) return false;
+  SILT::combineWords<SILT::SIMDWords::AndNot>(dst.raw32(),src.craw32(),dst.size());
+  return true;
 }
 
 template<> inline int Vol3D<VBit>::analyzeTypeID() const { return DT_BINARY; }
@@ -75,7 +110,6 @@ template<> inline bool Vol3D<VBit>::encode(const Vol3D<uint8> &mask)
 {
   if (makeCompatible(mask)==false) return false;
   description = mask.description;
-  std::fill(data.begin(),data.end(),VBit(0)); // TODO: check if necessary
   Codec32::encode(mask.start(),raw32(),cx,cy,cz);
   return true;
 }
@@ -108,28 +142,22 @@ template<> inline bool Vol3D<VBit>::setsize(const dim_type cx_, const dim_type c
 }
 
 // move to vBit
+// bitwise operations work on whole words; bits past cx are ignored by the counts below.
 inline bool opAnd(Vol3D<VBit> &dst, Vol3D<VBit> &src)
 {
-  if (dst.isCompatible(src))
-  {
-    int ds = dst.size();
-    auto *d = dst.raw32();
-    auto *s = src.craw32();
-    for (int i=0;i<ds;i++) d[i] &= s[i];
-    return true;
-  }
-  else
-    return false;
+  if (!dst.isCompatible(src)) return false;
+  SILT::combineWords<SILT::SIMDWords::And>(dst.raw32(),src.craw32(),dst.size());
+  return true;
 }
 
 inline bool opAnd(Vol3D<uint8> &dst, Vol3D<uint8> &src)
 {
   if (dst.isCompatible(src))
   {
-    int ds = dst.size();
+    const size_t ds = dst.size();
     auto *d = dst.start();
     auto *s = src.start();
-    for (int i=0;i<ds;i++) d[i] &= s[i];
+    for (size_t i=0;i<ds;i++) d[i] &= s[i];
     return true;
   }
   else
@@ -138,59 +166,74 @@ inline bool opAnd(Vol3D<uint8> &dst, Vol3D<uint8> &src)
 
 inline bool copy(Vol3D<VBit> &dst, const Vol3D<VBit> &src)
 {
-  if (dst.makeCompatible(src))
+  if (!dst.makeCompatible(src)) return false;
+  uint32 *d = dst.raw32();
+  const uint32 *s = src.craw32();
+  SILT::parallelFor(dst.size(),[&](const size_t i0, const size_t i1, const int)
   {
-    int ds = dst.size();
-    auto *d = dst.raw32();
-    auto *s = src.craw32();
-    for (int i=0;i<ds;i++) d[i] = s[i];
-    return true;
-  }
-  else
-    return false;
+    std::copy(s+i0,s+i1,d+i0);
+  },size_t(1)<<16);
+  return true;
 }
 
 inline bool opOr(Vol3D<VBit> &dst, const Vol3D<VBit> &src)
 {
-  if (dst.isCompatible(src))
-  {
-    int ds = dst.size();
-    auto *d = dst.raw32();
-    auto *s = src.craw32();
-    for (int i=0;i<ds;i++) d[i] |= s[i];
-    return true;
-  }
-  else
-    return false;
+  if (!dst.isCompatible(src)) return false;
+  SILT::combineWords<SILT::SIMDWords::Or>(dst.raw32(),src.craw32(),dst.size());
+  return true;
 }
 
 inline bool opAnd(Vol3D<VBit> &dst, const Vol3D<VBit> &src)
 {
-  if (dst.isCompatible(src))
-  {
-    int ds = dst.size();
-    auto *d = dst.raw32();
-    auto *s = src.craw32();
-    for (int i=0;i<ds;i++) d[i] &= s[i];
-    return true;
-  }
-  else
-    return false;
+  if (!dst.isCompatible(src)) return false;
+  SILT::combineWords<SILT::SIMDWords::And>(dst.raw32(),src.craw32(),dst.size());
+  return true;
 }
 
 inline bool setDifference(Vol3D<VBit> &dst, const Vol3D<VBit> &src)
 // computes dst = dst \ src
 {
-  if (dst.isCompatible(src))
-  {
-    int ds = dst.size();
-    auto *d = dst.raw32();
-    auto *s = src.craw32();
-    for (int i=0;i<ds;i++) d[i] &= (d[i] ^ s[i]);
-    return true;
-  }
-  else
-    return false;
+  if (!dst.isCompatible(src)) return false;
+  SILT::combineWords<SILT::SIMDWords::AndNot>(dst.raw32(),src.craw32(),dst.size());
+  return true;
+}
+
+// voxel counts, computed with popcounts on the code words
+inline std::vector<size_t> sliceCounts(const Vol3D<VBit> &v)
+{
+  const uint32 *w = v.craw32();
+  return SILT::countSliceBits(v.cx,v.cy,v.cz,wordsPerLine(v.cx),[w](const size_t i) { return w[i]; });
+}
+
+inline size_t countVoxels(const Vol3D<VBit> &v)
+{
+  const auto counts = sliceCounts(v);
+  return std::accumulate(counts.begin(),counts.end(),size_t(0));
+}
+
+inline size_t countIntersection(const Vol3D<VBit> &a, const Vol3D<VBit> &b)
+// number of voxels set in both a and b; 0 if they are not compatible
+{
+  if (!a.isCompatible(b)) return 0;
+  const uint32 *wa = a.craw32(), *wb = b.craw32();
+  const auto counts = SILT::countSliceBits(a.cx,a.cy,a.cz,wordsPerLine(a.cx),[wa,wb](const size_t i) { return wa[i] & wb[i]; });
+  return std::accumulate(counts.begin(),counts.end(),size_t(0));
+}
+
+inline size_t countUnion(const Vol3D<VBit> &a, const Vol3D<VBit> &b)
+// number of voxels set in a or b; 0 if they are not compatible
+{
+  if (!a.isCompatible(b)) return 0;
+  const uint32 *wa = a.craw32(), *wb = b.craw32();
+  const auto counts = SILT::countSliceBits(a.cx,a.cy,a.cz,wordsPerLine(a.cx),[wa,wb](const size_t i) { return wa[i] | wb[i]; });
+  return std::accumulate(counts.begin(),counts.end(),size_t(0));
+}
+
+inline double dice(const Vol3D<VBit> &a, const Vol3D<VBit> &b)
+// Dice coefficient 2|a and b|/(|a|+|b|); 1 if both are empty
+{
+  const size_t total = countVoxels(a) + countVoxels(b);
+  return (total>0) ? 2.0*double(countIntersection(a,b))/double(total) : 1.0;
 }
 
 #endif
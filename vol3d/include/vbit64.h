@@ -0,0 +1,231 @@
+// Copyright (C) 2025 The Regents of the University of California
+//
+// Created by David W. Shattuck, Ph.D.
+//
+// This file is part of maskbackgroundnoise.
+//
+// maskbackgroundnoise is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, version 2.1.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+
+#ifndef VBit64_H
+#define VBit64_H
+
+#include <vbit.h>
+#include <DS/codec64.h>
+#include <DS/simdwords.h>
+#include <algorithm>
+
+//! \brief One cache line of a bit volume: eight 64-bit words.
+//! \details Vol3D<VBit64> stores each scanline in a whole number of cache lines, so every line starts on
+//!          a 64-byte boundary. Bit (x&63) of word (x>>6) of a line holds voxel x, and bits at or beyond
+//!          cx are always 0. On little-endian hosts a line is also a valid row of 32-bit VBit words, which
+//!          lets the 32-bit kernels run on it through raw32() with a stride of 2*wordsPerLine64(cx).
+class alignas(64) VBit64 {
+public:
+  static constexpr int nWords = 8;
+  VBit64() : data{} {}
+  uint64 data[nWords];
+};
+
+//! number of 64-bit words in a padded scanline of a Vol3D<VBit64>
+inline Vol3DBase::dim_type wordsPerLine64(const Vol3DBase::dim_type cx)
+{
+  return ((cx + 511)/512)*VBit64::nWords;
+}
+
+template<> inline Vol3DBase::dim_type Vol3D<VBit64>::size() const
+{
+  return data.size();
+}
+
+template<> inline bool Vol3D<VBit64>::setsize(const dim_type cx_, const dim_type cy_, const dim_type cz_)
+{
+  const size_t nElements = size_t(wordsPerLine64(cx_)/VBit64::nWords) * size_t(cy_) * size_t(cz_);
+  data.resize(nElements);
+  if (data.size()==nElements)
+  {
+    cx = cx_;
+    cy = cy_;
+    cz = cz_;
+  }
+  else
+  {
+    return false;
+  }
+  return true;
+}
+
+template<> inline bool Vol3D<VBit64>::maskWith(const Vol3D<uint8> &vMask)
+{
+  if (isCompatible(vMask)==false) return false;
+  return true;
+}
+
+template<> inline bool Vol3D<VBit64>::copy(const Vol3D<VBit64> &vSource)
+{
+  if (!makeCompatible(vSource)) return false;
+  data=vSource.data;
+  return true;
+}
+
+template<> inline bool Vol3D<VBit64>::copyCast(std::unique_ptr<Vol3DBase> &dst) const
+{
+  auto newVol = std::make_unique<Vol3D<VBit64>>();
+  if (!newVol->copy(*this)) return false;
+  dst = std::move(newVol);
+  return true;
+}
+
+template<> inline int Vol3D<VBit64>::analyzeTypeID() const { return DT_BINARY; }
+template<> inline SILT::DataType Vol3D<VBit64>::typeID() const { return SILT::Unknown; }
+template<> inline bool Vol3D<VBit64>::write(std::string /* ofname */)
+{
+  std::cerr<<"writing of Vol3D<VBit64> is not currently implemented."<<std::endl;
+  return false;
+}
+template<> inline bool Vol3D<VBit64>::readNifti(std::string /* ifname */, Vol3DBase::AutoRotateCode)
+{
+  std::cerr<<"reading of Vol3D<VBit64> is not currently implemented."<<std::endl;
+  return false;
+}
+template<> inline bool Vol3D<VBit64>::read(std::string ifname, Vol3DBase::AutoRotateCode autoRotate)
+{
+  return readNifti(ifname,autoRotate);
+}
+template<> inline bool Vol3D<VBit64>::read(const Vol3DQuery &/* query */, Vol3DBase::AutoRotateCode autoRotate)
+{
+  return readNifti("",autoRotate);
+}
+
+template<> inline bool Vol3D<VBit64>::encode(const Vol3D<uint8> &mask)
+{
+  if (makeCompatible(mask)==false) return false;
+  description = mask.description;
+  Codec64::encode(mask.start(),raw64(),cx,cy,cz,wordsPerLine64(cx));
+  return true;
+}
+
+template<> inline bool Vol3D<VBit64>::decode(Vol3D<uint8> &mask)
+{
+  if (mask.makeCompatible(*this)==false) return false;
+  mask.description = description;
+  Codec64::decode(craw64(),mask.start(),cx,cy,cz,wordsPerLine64(cx));
+  return true;
+}
+
+//! converts a 32-bit VBit volume to the padded 64-bit layout; padding bits are cleared.
+inline bool convert(Vol3D<VBit64> &dst, const Vol3D<VBit> &src)
+{
+  if (!dst.makeCompatible(src)) return false;
+  const size_t wpl32 = wordsPerLine(src.cx);
+  const size_t stride = 2*wordsPerLine64(src.cx);
+  const size_t nLines = size_t(src.cy)*size_t(src.cz);
+  const uint32 lastMask = (src.cx&0x1F) ? (uint32(1)<<(src.cx&0x1F))-1 : 0xFFFFFFFF;
+  const uint32 *s = src.craw32();
+  uint32 *d = dst.raw32();
+  for (size_t line=0;line<nLines;line++,s+=wpl32,d+=stride)
+  {
+    std::copy(s,s+wpl32,d);
+    if (wpl32) d[wpl32-1] &= lastMask;
+    std::fill(d+wpl32,d+stride,0);
+  }
+  return true;
+}
+
+//! converts a padded 64-bit VBit volume to the 32-bit layout.
+inline bool convert(Vol3D<VBit> &dst, const Vol3D<VBit64> &src)
+{
+  if (!dst.makeCompatible(src)) return false;
+  const size_t wpl32 = wordsPerLine(src.cx);
+  const size_t stride = 2*wordsPerLine64(src.cx);
+  const size_t nLines = size_t(src.cy)*size_t(src.cz);
+  const uint32 *s = src.craw32();
+  uint32 *d = dst.raw32();
+  for (size_t line=0;line<nLines;line++,s+=stride,d+=wpl32)
+    std::copy(s,s+wpl32,d);
+  return true;
+}
+
+// bitwise operations; padding words are 0 in both operands, so whole lines can be processed.
+inline bool opAnd(Vol3D<VBit64> &dst, const Vol3D<VBit64> &src)
+{
+  if (!dst.isCompatible(src)) return false;
+  SILT::combineWords<SILT::SIMDWords::And>(dst.raw32(),src.craw32(),dst.size()*VBit64::nWords*2);
+  return true;
+}
+
+inline bool opOr(Vol3D<VBit64> &dst, const Vol3D<VBit64> &src)
+{
+  if (!dst.isCompatible(src)) return false;
+  SILT::combineWords<SILT::SIMDWords::Or>(dst.raw32(),src.craw32(),dst.size()*VBit64::nWords*2);
+  return true;
+}
+
+inline bool copy(Vol3D<VBit64> &dst, const Vol3D<VBit64> &src)
+{
+  return dst.copy(src);
+}
+
+inline bool setDifference(Vol3D<VBit64> &dst, const Vol3D<VBit64> &src)
+// computes dst = dst \ src
+{
+  if (!dst.isCompatible(src)) return false;
+  SILT::combineWords<SILT::SIMDWords::AndNot>(dst.raw32(),src.craw32(),dst.size()*VBit64::nWords*2);
+  return true;
+}
+
+inline bool setDiff(Vol3D<VBit64> &dst, Vol3D<VBit64> &src)
+{
+  return setDifference(dst,src);
+}
+
+// voxel counts, computed with popcounts on the 32-bit halves of the code words
+inline std::vector<size_t> sliceCounts(const Vol3D<VBit64> &v)
+{
+  const uint32 *w = v.craw32();
+  return SILT::countSliceBits(v.cx,v.cy,v.cz,2*wordsPerLine64(v.cx),[w](const size_t i) { return w[i]; });
+}
+
+inline size_t countVoxels(const Vol3D<VBit64> &v)
+{
+  const auto counts = sliceCounts(v);
+  return std::accumulate(counts.begin(),counts.end(),size_t(0));
+}
+
+inline size_t countIntersection(const Vol3D<VBit64> &a, const Vol3D<VBit64> &b)
+// number of voxels set in both a and b; 0 if they are not compatible
+{
+  if (!a.isCompatible(b)) return 0;
+  const uint32 *wa = a.craw32(), *wb = b.craw32();
+  const auto counts = SILT::countSliceBits(a.cx,a.cy,a.cz,2*wordsPerLine64(a.cx),[wa,wb](const size_t i) { return wa[i] & wb[i]; });
+  return std::accumulate(counts.begin(),counts.end(),size_t(0));
+}
+
+inline size_t countUnion(const Vol3D<VBit64> &a, const Vol3D<VBit64> &b)
+// number of voxels set in a or b; 0 if they are not compatible
+{
+  if (!a.isCompatible(b)) return 0;
+  const uint32 *wa = a.craw32(), *wb = b.craw32();
+  const auto counts = SILT::countSliceBits(a.cx,a.cy,a.cz,2*wordsPerLine64(a.cx),[wa,wb](const size_t i) { return wa[i] | wb[i]; });
+  return std::accumulate(counts.begin(),counts.end(),size_t(0));
+}
+
+inline double dice(const Vol3D<VBit64> &a, const Vol3D<VBit64> &b)
+// Dice coefficient 2|a and b|/(|a|+|b|); 1 if both are empty
+{
+  const size_t total = countVoxels(a) + countVoxels(b);
+  return (total>0) ? 2.0*double(countIntersection(a,b))/double(total) : 1.0;
+}
+
+#endif
@@ -33,6 +33,8 @@
 #include <eigensystem3x3.h>
 #include <rgb8.h>
 #include <vector>
+#include <functional>
+#include <DS/voxelstore.h>
 
 namespace SILT { class izstream; }
 
@@ -47,12 +49,19 @@ public:
   void releaseMemory()
   {
     cx=cy=cz=0;
-    std::vector<Datatype>().swap(data);
+    SILT::VoxelStore<Datatype>().swap(data);
   }
-  size_t readDataStream(SILT::izstream &ifile);
+  typedef std::function<void(Datatype *first, Datatype *last, const int worker)> ReadProcessor;
+  //! optional per-chunk work run on the voxels as they are read, in file order and after byte swapping;
+  //! chunks are processed concurrently, and worker is in [0,SILT::ThreadControl::nThreads())
+  ReadProcessor readProcessor;
+  size_t readDataStream(SILT::izstream &ifile, const bool swapBytes=false);
   virtual bool readNifti(std::string ifname, AutoRotateCode autoRotate=RotateToRAS) override;
   virtual bool read(std::string ifname, Vol3DBase::AutoRotateCode autoRotate=RotateToRAS) override;
   virtual bool read(const Vol3DQuery &query, AutoRotateCode autoRotate=RotateToRAS) override; // assumes query has already been run
+  bool readZRange(std::string ifname, const int z0, const int z1); // reads slices [z0,z1) in file order
+  bool mapFile(const std::string &ifname, const uint64_t offset, const dim_type cx_, const dim_type cy_, const dim_type cz_);
+  bool isMapped() const { return data.isMapped(); }
   virtual bool write (std::string ifile) override;
   // data info
   SILT::DataType typeID() const override { return SILT::Unknown; } // specialize for given types
@@ -173,7 +182,8 @@ private:
     }
   }
 protected:
-  std::vector<Datatype> data;
+  void processReadVoxels(const bool swapBytes); // applies the byte swap and readProcessor to data that was not streamed
+  SILT::VoxelStore<Datatype> data;
 };
 
 template<> inline int Vol3D<uint8>::minVal() const { return 0; }
@@ -25,28 +25,71 @@
 #include <vol3d.h>
 #include <vol3dquery.h>
 #include <zstream.h>
+#include <DS/gzmembers.h>
+#include <DS/gzindex.h>
+#include <DS/overlappedreader.h>
+#include <DS/parallelfor.h>
 #include <endianswap.h>
 #include <dsnifti.h>
 #include <siltbyteswap.h>
 #include <vol3dreorder.h>
 
 template <class T>
-size_t Vol3D<T>::readDataStream(SILT::izstream &ifile)
+void Vol3D<T>::processReadVoxels(const bool swapBytes)
+{
+  if (!swapBytes && !readProcessor) return;
+  T *src = size() ? start() : nullptr;
+  SILT::parallelFor(size(),[&](const size_t first, const size_t last, const int block)
+  {
+    if (swapBytes) SILT::byteswap(src+first,last-first);
+    if (readProcessor) readProcessor(src+first,src+last,block);
+  },SILT::OverlappedReader::defaultChunkSize/sizeof(T));
+}
+
+template <class T>
+size_t Vol3D<T>::readDataStream(SILT::izstream &ifile, const bool swapBytes)
 {
   size_t bytesReadTotal = 0;
   size_t bytesInImage=size()*sizeof(T);
-  unsigned chunkSize = 1024*1024*1024; // matches type used in ifile.read
-  size_t bytesRemaining=bytesInImage;
-  char *dst=reinterpret_cast<char *>(&data[0]);
-  while (bytesRemaining>0)
+  SILT::GZMemberReader members;
+  if (!ifile.name().empty() && members.open(ifile.name()))
   {
-    size_t bytesToRead=chunkSize<bytesRemaining ? chunkSize : bytesRemaining;
-    auto bytesRead=ifile.read(dst,bytesToRead);
-    if (bytesRead<=0) { std::cerr<<"error reading file: read incorrect number of bytes"<<std::endl; break; }
-    dst += bytesRead;
-    bytesReadTotal += static_cast<decltype(bytesReadTotal)>(bytesRead);
-    bytesRemaining -= static_cast<decltype(bytesRemaining)>(bytesRead);
-    if (bytesRead != static_cast<decltype(bytesRead)>(bytesToRead)) break;
+    const z_off_t offset = ifile.tellg();
+    if ((offset>=0) && members.read(reinterpret_cast<char *>(&data[0]),uint64_t(offset),bytesInImage))
+    {
+      processReadVoxels(swapBytes);
+      return bytesInImage;
+    }
+  }
+  if (swapBytes || readProcessor)
+  {
+// swap and process each chunk on the worker threads while the next one is decompressed
+    T *src = size() ? start() : nullptr;
+    SILT::OverlappedReader reader;
+    bytesReadTotal = reader.read(ifile,reinterpret_cast<char *>(src),bytesInImage,sizeof(T),[&](const size_t first, const size_t last, const int worker)
+    {
+      T *p = src + first/sizeof(T);
+      const size_t n = (last-first)/sizeof(T);
+      if (swapBytes) SILT::byteswap(p,n);
+      if (readProcessor) readProcessor(p,p+n,worker);
+    });
+    if ((bytesReadTotal==0)&&(bytesInImage>0)) std::cerr<<"error reading file: read incorrect number of bytes"<<std::endl;
+  }
+  else
+  {
+    unsigned chunkSize = 1024*1024*1024; // matches type used in ifile.read
+    size_t bytesRemaining=bytesInImage;
+    char *dst=reinterpret_cast<char *>(&data[0]);
+    while (bytesRemaining>0)
+    {
+      size_t bytesToRead=chunkSize<bytesRemaining ? chunkSize : bytesRemaining;
+      auto bytesRead=ifile.read(dst,bytesToRead);
+      if (bytesRead<=0) { std::cerr<<"error reading file: read incorrect number of bytes"<<std::endl; break; }
+      dst += bytesRead;
+      bytesReadTotal += static_cast<decltype(bytesReadTotal)>(bytesRead);
+      bytesRemaining -= static_cast<decltype(bytesRemaining)>(bytesRead);
+      if (bytesRead != static_cast<decltype(bytesRead)>(bytesToRead)) break;
+    }
   }
   if (bytesReadTotal != size()*sizeof(T))
   {
@@ -68,19 +111,8 @@ bool Vol3D<T>::readNifti(std::string ifname, Vol3DBase::AutoRotateCode autoRotat
     swapped=true;
     Vol3DQuery::swapNIFTIHeader(header);
   }
-  if (!setsize(header.dim[1],header.dim[2],header.dim[3]))
-  {
-    std::cerr<<"Unable to allocate memory for new image.\n"<<std::endl;
-    return false;
-  }
   scl_slope=header.scl_slope;
   scl_inter=header.scl_inter;
-  ifile.seekg(static_cast<off_t>(header.vox_offset),std::ios::beg); // TODO: should really test if header.vox_offset is valid
-  readDataStream(ifile);
-  if (swapped)
-  {
-    SILT::byteswap(&data[0],size()); // TODO: change to vector input
-  }
   if (scanQForm(header))
   {
 // read image dimensions/coordinates from q-form -- no need to read from s-form
@@ -93,6 +125,21 @@ bool Vol3D<T>::readNifti(std::string ifname, Vol3DBase::AutoRotateCode autoRotat
     else
       std::cerr<<"couldn't read coordinate system -- assuming analyze"<<std::endl;
   }
+  const bool reorder = (autoRotate==Vol3DBase::RotateToRAS) && !Vol3DBase::noRotate && !Vol3DReorder::isCanonical(*this);
+  const bool mapped = memoryMap && !swapped && !reorder && !StrUtil::isGZ(ifname)
+    && mapFile(ifname,static_cast<uint64_t>(header.vox_offset),header.dim[1],header.dim[2],header.dim[3]);
+  if (!mapped)
+  {
+    if (!setsize(header.dim[1],header.dim[2],header.dim[3]))
+    {
+      std::cerr<<"Unable to allocate memory for new image.\n"<<std::endl;
+      return false;
+    }
+    ifile.seekg(static_cast<off_t>(header.vox_offset),std::ios::beg); // TODO: should really test if header.vox_offset is valid
+    readDataStream(ifile,swapped);
+  }
+  else
+    processReadVoxels(false);
   if ((autoRotate==Vol3DBase::RotateToRAS)&&!Vol3DBase::noRotate)
   {
     if (Vol3DReorder::isCanonical(*this)==false)
@@ -118,16 +165,22 @@ bool Vol3D<T>::read(const Vol3DQuery &vq, Vol3DBase::AutoRotateCode autoRotate)
         std::cerr<<"unable to read "<<vq.filename<<std::endl;
         return false;
       }
-      if (!setsize(vq.cx,vq.cy,vq.cz))
-      {
-        std::cerr<<"Unable to allocate memory "<<std::endl;
-        return false;
-      }
       rx = vq.rx;
       ry = vq.ry;
       rz = vq.rz;
-      readDataStream(ifile); // need to check read size
-      if (vq.swapped) SILT::byteswap(&data[0],size());
+      const bool mapped = memoryMap && !vq.swapped && !vq.compressed && (rx>0) && (ry>0) && (rz>0)
+        && mapFile(vq.filename,0,vq.cx,vq.cy,vq.cz);
+      if (!mapped)
+      {
+        if (!setsize(vq.cx,vq.cy,vq.cz))
+        {
+          std::cerr<<"Unable to allocate memory "<<std::endl;
+          return false;
+        }
+        readDataStream(ifile,vq.swapped); // need to check read size
+      }
+      else
+        processReadVoxels(false);
       if (rx<0) { Vol3DReorder::flipX(*this); rx=-rx; }
       if (ry<0) { Vol3DReorder::flipY(*this); ry=-ry; }
       if (rz<0) { Vol3DReorder::flipZ(*this); rz=-rz; }
@@ -160,11 +213,7 @@ bool Vol3D<T>::read(const Vol3DQuery &vq, Vol3DBase::AutoRotateCode autoRotate)
         rx = vq.rx;
         ry = vq.ry;
         rz = vq.rz;
-        readDataStream(ifile);
-        if (swapped)
-        {
-          SILT::byteswap(&data[0],size());
-        }
+        readDataStream(ifile,swapped);
         if (scanQForm(header))
         {
       //read image dimensions/coordinates from q-form -- no need to read from s-form
@@ -209,6 +258,71 @@ bool Vol3D<T>::read(std::string ifname, Vol3DBase::AutoRotateCode autoRotate)
   return read(vq,autoRotate);
 }
 
+//! \brief Replaces the voxel data with a copy-on-write mapping of the data stored at offset in ifname.
+//! \details Fails, leaving the volume unchanged, if the file is too short, the offset is not aligned
+//!          for the voxel type, or the file cannot be mapped; the caller then reads the data instead.
+template <class T>
+bool Vol3D<T>::mapFile(const std::string &ifname, const uint64_t offset, const dim_type cx_, const dim_type cy_, const dim_type cz_)
+{
+  if (!data.map(ifname,offset,size_t(cx_)*size_t(cy_)*size_t(cz_))) return false;
+  cx = cx_;
+  cy = cy_;
+  cz = cz_;
+  return true;
+}
+
+//! \brief Reads slices [z0,z1) of a volume in file order, without reorientation or intensity scaling.
+//! \details Only the bytes of the requested slices are decompressed when possible: files written by
+//!          GZMemberWriter are read member by member, and other .gz files use a sidecar GZIndex, which
+//!          is built on the first partial read when gzIndexSpan is nonzero.
+template <class T>
+bool Vol3D<T>::readZRange(std::string ifname, const int z0, const int z1)
+{
+  filename = ifname;
+  Vol3DQuery vq;
+  if (!vq.query(ifname)) return false;
+  if ((z0<0)||(z1>vq.cz)||(z0>=z1))
+  {
+    std::cerr<<"slice range ["<<z0<<","<<z1<<") is outside "<<ifname<<std::endl;
+    return false;
+  }
+  if (!setsize(vq.cx,vq.cy,z1-z0))
+  {
+    std::cerr<<"Unable to allocate memory "<<std::endl;
+    return false;
+  }
+  rx = std::abs(vq.rx);
+  ry = std::abs(vq.ry);
+  rz = std::abs(vq.rz);
+  const size_t sliceBytes = size_t(cx)*cy*sizeof(T);
+  const uint64_t offset = uint64_t(vq.datastart) + uint64_t(z0)*sliceBytes;
+  const size_t bytes = size()*sizeof(T);
+  bool loaded = false;
+  if (vq.compressed && (gzIndexSpan>0))
+  {
+    SILT::GZMemberReader members;
+    if (!members.open(vq.filename)) // member files are read by readDataStream
+    {
+      SILT::GZIndex index;
+      loaded = index.open(vq.filename,gzIndexSpan) && index.read(reinterpret_cast<char *>(&data[0]),offset,bytes);
+    }
+  }
+  if (!loaded)
+  {
+    SILT::izstream ifile(vq.filename);
+    if (!ifile)
+    {
+      std::cerr<<"unable to read "<<vq.filename<<std::endl;
+      return false;
+    }
+    ifile.seekg(static_cast<z_off_t>(offset),SEEK_SET);
+    if (readDataStream(ifile,vq.swapped)!=bytes) return false;
+  }
+  else
+    processReadVoxels(vq.swapped);
+  return true;
+}
+
 template <class T>
 bool Vol3D<T>::write(std::string ofname)
 {
@@ -222,26 +336,12 @@ bool Vol3D<T>::write(std::string ofname)
     setHeader(hdr);
     if (compress)
     {
-      SILT::ozstream ofile(ofname.c_str());
-      if (!ofile) return false;
-      ofile.write(static_cast<void *>(&hdr), sizeof(hdr));
+      SILT::GZMemberWriter ofile(compressionLevel);
       char buf[4]={0,0,0,0};
-      ofile.write(buf,4);
-      {
-        size_t bytesInImage=cx*cy*cz*sizeof(T);
-        size_t chunkSize = 1024*1024*1024;
-        size_t bytesRemaining=bytesInImage;
-        char *src=reinterpret_cast<char *>(&data[0]);
-        while (bytesRemaining>0)
-        {
-          size_t bytesToWrite=chunkSize<bytesRemaining ? chunkSize : bytesRemaining;
-          auto bytesWritten=ofile.write(src, bytesToWrite);
-          src += bytesWritten;
-          if (bytesWritten<=0) { std::cerr<<"error saving "<<ofname<<std::endl; break; }
-          bytesRemaining -= static_cast<decltype(bytesRemaining)>(bytesWritten); // bytesWritten should never be negative
-          if (bytesWritten != static_cast<decltype(bytesWritten)>(bytesToWrite)) { std::cerr<<"error saving "<<ofname<<": wrote incorrect number of bytes "<<std::endl; break; }
-        }
-      }
+      ofile.add(&hdr, sizeof(hdr));
+      ofile.add(buf,4);
+      ofile.add(&data[0], cx*cy*cz*sizeof(T));
+      if (!ofile.write(ofname)) return false;
     }
     else
     {
@@ -273,9 +373,9 @@ bool Vol3D<T>::write(std::string ofname)
     niftiHeader.magic[3]='\0';
     if (compress)
     {
-      SILT::ozstream ofile(ofname);
-      if (!ofile) return false;
-      ofile.write(static_cast<void *>(&data[0]), cx*cy*cz*sizeof(T));
+      SILT::GZMemberWriter ofile(compressionLevel);
+      ofile.add(&data[0], cx*cy*cz*sizeof(T));
+      if (!ofile.write(ofname)) return false;
     }
     else
     {
@@ -305,6 +405,8 @@ bool Vol3D<T>::maskWith(const Vol3D<uint8> &vMask)
   template bool Vol3D<T>::read(std::string, Vol3DBase::AutoRotateCode);\
   template bool Vol3D<T>::read(const Vol3DQuery &, Vol3DBase::AutoRotateCode);\
   template bool Vol3D<T>::write(std::string);\
+  template bool Vol3D<T>::readZRange(std::string, const int, const int);\
+  template bool Vol3D<T>::mapFile(const std::string &, const uint64_t, const dim_type, const dim_type, const dim_type);\
   template bool Vol3D<T>::copyCast(std::unique_ptr<Vol3DBase> &) const; \
   template bool Vol3D<T>::maskWith(const Vol3D<uint8> &);\
   template bool Vol3D<T>::readNifti(std::string, Vol3DBase::AutoRotateCode);
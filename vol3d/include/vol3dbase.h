@@ -44,6 +44,9 @@ public:
 // I/O
   enum AutoRotateCode { NoRotate=0,RotateToRAS=1 };
   static bool noRotate; // global lock against autorotate
+  static int compressionLevel; // zlib level used by write for .gz output
+  static bool memoryMap; // map uncompressed inputs that need no byte swapping or reordering instead of copying them
+  static size_t gzIndexSpan; // checkpoint spacing of the sidecar index used for partial reads of .gz files (0 disables it)
   bool scanQForm(const nifti_1_header &header); // load voxel dimensions and orientation
   bool scanSForm(const nifti_1_header &header); // load voxel dimensions and orientation
   bool setQForm(nifti_1_header &header) const; // set voxel dimensions and orientation
@@ -0,0 +1,154 @@
+// Copyright (C) 2025 The Regents of the University of California
+//
+// Created by David W. Shattuck, Ph.D.
+//
+// This file is part of maskbackgroundnoise.
+//
+// maskbackgroundnoise is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, version 2.1.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+
+#ifndef Vol3DQuantile_H
+#define Vol3DQuantile_H
+
+#include <vol3d.h>
+#include <DS/parallelfor.h>
+#include <cstring>
+#include <numeric>
+#include <type_traits>
+#include <vector>
+
+//! \brief Computes exact order statistics (the n-th smallest value) of image volumes.
+//! \details Each value is mapped to an unsigned key with the same ordering, and the n-th key is found
+//!          one 16-bit digit at a time, most significant first, from histograms of the voxels that
+//!          match the digits found so far. The data are only read, never copied, and each histogram
+//!          pass is split across threads. 8- and 16-bit data take one pass, 32-bit data take two, and
+//!          64-bit data take four. The result is identical to std::nth_element on a copy of the data.
+class Vol3DQuantile {
+  template <class S, bool isFloat=std::is_floating_point_v<S>> struct Key { typedef std::make_unsigned_t<S> type; };
+  template <class S> struct Key<S,true> { typedef std::conditional_t<sizeof(S)==4,uint32,uint64> type; };
+public:
+  //! \brief Histogram of the most significant key digit, filled in chunks while a volume is being read.
+  //! \details Each worker adds to its own histogram; passing the result to nthValue replaces its first
+  //!          pass over the data.
+  template <class S> class TopDigits {
+  public:
+    typedef typename Key<S>::type KeyT;
+    static const int keyBits = sizeof(KeyT)*8;
+    static const int digitBits = (keyBits<16) ? keyBits : 16;
+    TopDigits(const int nWorkers=SILT::ThreadControl::nThreads()) : workers(nWorkers, std::vector<size_t>(size_t(1)<<digitBits,0)) {}
+    void add(const S *first, const S *last, const int worker)
+    {
+      auto &h = workers[worker];
+      for (const S *p=first;p<last;p++) h[toKey(*p)>>(keyBits-digitBits)]++;
+    }
+    std::vector<size_t> merged() const
+    {
+      std::vector<size_t> hgram(size_t(1)<<digitBits,0);
+      for (auto &h : workers)
+        for (size_t i=0;i<hgram.size();i++) hgram[i] += h[i];
+      return hgram;
+    }
+  private:
+    std::vector<std::vector<size_t>> workers;
+  };
+  //! n-th smallest value of proj(data[i]); proj must return an arithmetic type.
+  //! topDigits, if given, is the merged TopDigits histogram of the same values.
+  template <class T, class Proj> static auto nthValue(const T *data, const size_t ds, size_t n, Proj proj, const std::vector<size_t> *topDigits=nullptr)
+  {
+    typedef std::decay_t<decltype(proj(*data))> ValueT;
+    typedef typename Key<ValueT>::type KeyT;
+    const int keyBits = sizeof(KeyT)*8;
+    const int digitBits = (keyBits<16) ? keyBits : 16;
+    const size_t nBins = size_t(1)<<digitBits;
+    if (ds==0) return ValueT(0);
+    if (n>=ds) n = ds - 1;
+    const int nThreads = SILT::ThreadControl::nThreads();
+    std::vector<std::vector<size_t>> histograms(nThreads);
+    KeyT prefix = 0;
+    KeyT prefixMask = 0;
+    for (int shift=keyBits-digitBits; shift>=0; shift-=digitBits)
+    {
+      auto &hgram = histograms[0];
+      if (topDigits && (shift==keyBits-digitBits) && (topDigits->size()==nBins) && (std::accumulate(topDigits->begin(),topDigits->end(),size_t(0))==ds))
+        hgram = *topDigits;
+      else
+      {
+        const int nBlocks = SILT::parallelFor(ds, [&](const size_t begin, const size_t end, const int blockID)
+        {
+          auto &h = histograms[blockID];
+          h.assign(nBins,0);
+          for (size_t i=begin;i<end;i++)
+          {
+            const KeyT key = toKey(proj(data[i]));
+            if ((key&prefixMask)==prefix) h[(key>>shift)&(nBins-1)]++;
+          }
+        },minBlockSize,nThreads);
+        for (int b=1;b<nBlocks;b++)
+          for (size_t i=0;i<nBins;i++) hgram[i] += histograms[b][i];
+      }
+      size_t bin = 0;
+      for (;bin<nBins-1;bin++)
+      {
+        if (n<hgram[bin]) break;
+        n -= hgram[bin];
+      }
+      prefix |= KeyT(bin)<<shift;
+      prefixMask |= KeyT(nBins-1)<<shift;
+    }
+    return fromKey<ValueT>(prefix);
+  }
+  template <class T> static T nthValue(const Vol3D<T> &vol, const size_t n, const std::vector<size_t> *topDigits=nullptr)
+  {
+    return nthValue(vol.size() ? vol.start() : nullptr, vol.size(), n, [](const T v) { return v; }, topDigits);
+  }
+  static uint8 nthValue(const Vol3D<rgb8> &vol, const size_t n) // uses the red channel, as in ThresholdTools
+  {
+    return nthValue(vol.size() ? vol.start() : nullptr, vol.size(), n, [](const rgb8 &v) { return v.r; });
+  }
+  static constexpr size_t minBlockSize = 1<<20; // voxels per thread; smaller volumes are not split
+private:
+  template <class S> static typename Key<S>::type toKey(const S v)
+  {
+    static_assert(std::is_arithmetic_v<S>,"Vol3DQuantile requires an arithmetic value type");
+    typedef typename Key<S>::type U;
+    if constexpr (std::is_floating_point_v<S>)
+    {
+      const U signBit = U(1)<<(sizeof(S)*8-1);
+      U u;
+      std::memcpy(&u,&v,sizeof(S));
+      return (u&signBit) ? U(~u) : U(u|signBit);
+    }
+    else if constexpr (std::is_signed_v<S>)
+      return U(U(v)^(U(1)<<(sizeof(S)*8-1)));
+    else
+      return v;
+  }
+  template <class S, class U> static S fromKey(const U key)
+  {
+    if constexpr (std::is_floating_point_v<S>)
+    {
+      const U signBit = U(1)<<(sizeof(S)*8-1);
+      const U u = (key&signBit) ? U(key^signBit) : U(~key);
+      S v;
+      std::memcpy(&v,&u,sizeof(S));
+      return v;
+    }
+    else if constexpr (std::is_signed_v<S>)
+      return S(U(key^(U(1)<<(sizeof(S)*8-1))));
+    else
+      return S(key);
+  }
+};
+
+#endif
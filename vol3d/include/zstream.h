@@ -22,6 +22,7 @@
 #define SILT_ZStream_H
 
 #include <sstream>
+#include <string>
 
 #ifdef WIN32
 #ifndef ZLIB_WINAPI
@@ -42,10 +43,13 @@ public:
   izstream(std::string ifname) { open(ifname); }
   ~izstream() { close(); }
   z_off_t seekg(z_off_t offset, int whence=SEEK_SET) { return  gzseek (fp, offset, whence); }
+  z_off_t tellg() { return gztell(fp); } // position in the uncompressed stream
+  const std::string &name() const { return filename; }
   bool open(const char *ifname)
   {
     if (fp) close();
     fp = ::gzopen(ifname, "rb");
+    filename = (fp!=nullptr) ? ifname : "";
     return (fp!=nullptr);
   }
   bool open(const std::string ifname)
@@ -65,6 +69,7 @@ public:
   }
 private:
   gzFile fp{nullptr};
+  std::string filename;
 };
 
 //! \brief A simple output stream class for interfacing with gzipped files.
@@ -0,0 +1,109 @@
+// Copyright (C) 2025 The Regents of the University of California
+//
+// Created by David W. Shattuck, Ph.D.
+//
+// This file is part of maskbackgroundnoise.
+//
+// maskbackgroundnoise is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, version 2.1.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+
+#include <DS/voxelstore.h>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace SILT {
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string &filename, const uint64_t offset, const size_t length_)
+{
+  close();
+  HANDLE file = CreateFileA(filename.c_str(),GENERIC_READ,FILE_SHARE_READ,nullptr,OPEN_EXISTING,FILE_FLAG_SEQUENTIAL_SCAN,nullptr);
+  if (file==INVALID_HANDLE_VALUE) return false;
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(file,&fileSize) || (uint64_t(fileSize.QuadPart)<offset+length_))
+  {
+    CloseHandle(file);
+    return false;
+  }
+  HANDLE mapping = CreateFileMappingA(file,nullptr,PAGE_WRITECOPY,0,0,nullptr);
+  CloseHandle(file);
+  if (!mapping) return false;
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  const uint64_t viewOffset = offset - offset%info.dwAllocationGranularity;
+  viewLength = size_t(offset-viewOffset) + length_;
+  view = MapViewOfFile(mapping,FILE_MAP_COPY,DWORD(viewOffset>>32),DWORD(viewOffset&0xFFFFFFFF),viewLength);
+  CloseHandle(mapping); // the view keeps the mapping alive
+  if (!view) return false;
+  address = static_cast<char *>(view) + (offset-viewOffset);
+  length = length_;
+  return true;
+}
+
+void MappedFile::close()
+{
+  if (view) UnmapViewOfFile(view);
+  view = address = nullptr;
+  viewLength = length = 0;
+}
+
+#else
+
+bool MappedFile::open(const std::string &filename, const uint64_t offset, const size_t length_)
+{
+  close();
+  const int fd = ::open(filename.c_str(),O_RDONLY);
+  if (fd<0) return false;
+  struct stat status;
+  if ((fstat(fd,&status)!=0) || (uint64_t(status.st_size)<offset+length_))
+  {
+    ::close(fd);
+    return false;
+  }
+  const uint64_t pageSize = uint64_t(sysconf(_SC_PAGESIZE));
+  const uint64_t viewOffset = offset - offset%pageSize;
+  viewLength = size_t(offset-viewOffset) + length_;
+  void *p = mmap(nullptr,viewLength,PROT_READ|PROT_WRITE,MAP_PRIVATE,fd,off_t(viewOffset));
+  ::close(fd); // the mapping keeps the file open
+  if (p==MAP_FAILED) { viewLength=0; return false; }
+  view = p;
+  madvise(view,viewLength,MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+  madvise(view,viewLength,MADV_HUGEPAGE);
+#endif
+  address = static_cast<char *>(view) + (offset-viewOffset);
+  length = length_;
+  return true;
+}
+
+void MappedFile::close()
+{
+  if (view) munmap(view,viewLength);
+  view = address = nullptr;
+  viewLength = length = 0;
+}
+
+#endif
+
+} // end of namespace SILT
@@ -22,298 +22,377 @@
 #include <iostream>
 #include <fstream>
 #include <DS/morph32.h>
+#include <DS/parallelfor.h>
+#include <DS/simdwords.h>
+#include <algorithm>
+#include <type_traits>
 
-void Morph32::erodeX32(uint32 *in, uint32 *out, const int cx, const int n)
-{
-  const int extra = (cx&0x1F);
-  const int wpl  = ((cx>>5)-1) + (extra ? 1 : 0);
-  for (int i=0;i<n;i++)
-  {
-    uint32 x = 0;
-    uint32 y = *in;
-    for (int j=0;j<wpl;j++)
-    {
-      uint32 z = *++in;
-      *out++ = y & ((x>>31)|(y<<1)) & ((y>>1)|(z<<31));
-      x = y;
-      y = z;
-    }
-    { *out++ = y & ((x>>31)|(y<<1)) & (y>>1); ++in; }
-  }
-}
+namespace {
+typedef SILT::SIMDWords SW;
+template <bool dilate> using OpFor = typename std::conditional<dilate,SW::Or,SW::And>::type;
 
-void Morph32::dilateX32(uint32 *in, uint32 *out, const int cx, const int n)
+// Row patterns select x shifts: bits 0, 1 and 2 select the voxels at x-1, x and x+1. Word y is the
+// current word of a row, and x and z are the words before and after it.
+template <uint32 row, bool dilate> inline uint32 xWord(const uint32 x, const uint32 y, const uint32 z)
 {
-  const int extra = (cx&0x1F);
-  const int wpl  = ((cx>>5)-1) + (extra ? 1 : 0);
-
-  for (int i=0;i<n;i++)
-  {
-    uint32 x = 0;
-    uint32 y = *in;
-    for (int j=0;j<wpl;j++)
-    {
-      uint32 z = *++in;
-      *out++ = y | (y<<1) | (y>>1) | (x>>31) | (z<<31);
-      x = y;
-      y = z;
-    }
-    { *out++ = y | (y<<1) | (y>>1) | (x>>31); ++in; }
-  }
+  typedef OpFor<dilate> Op;
+  const uint32 l = (y<<1)|(x>>31);
+  const uint32 r = (y>>1)|(z<<31);
+  uint32 v = (row&2) ? y : (row&1) ? l : r;
+  if constexpr ((row&3)==3) v = Op::apply1(v,l);
+  if constexpr ((row&4) && (row&3)) v = Op::apply1(v,r);
+  return v;
 }
 
-void Morph32::dilateY32(uint32 *in, uint32 *out, const int cx, const int cy, const int cz)
+template <uint32 row, bool dilate> inline SW::V xVector(const SW::V x, const SW::V y, const SW::V z)
 {
-  const int wpl  = (cx>>5) + ((cx&0x1F)!=0);
-  const int ys = cy - 1;
-  uint32 *o = out;
-  uint32 *i = in;
-  for (int z=0;z<cz;z++)
-  {
-    for (int x=0;x<wpl;x++,o++,i++) o[0] = i[0] | i[wpl];
-    for (int y=1;y<ys;y++)
-    {
-      for (int x=0;x<wpl;x++,o++,i++)
-        o[0] = i[-wpl] | i[0] | i[wpl];
-    }
-    for (int x=0;x<wpl;x++,o++,i++) o[0] = i[-wpl] | i[0];
-  }
+  typedef OpFor<dilate> Op;
+  const SW::V l = SW::orv(SW::shl<1>(y),SW::shr<31>(x));
+  const SW::V r = SW::orv(SW::shr<1>(y),SW::shl<31>(z));
+  SW::V v = (row&2) ? y : (row&1) ? l : r;
+  if constexpr ((row&3)==3) v = Op::apply(v,l);
+  if constexpr ((row&4) && (row&3)) v = Op::apply(v,r);
+  return v;
 }
 
-void Morph32::erodeY32(uint32 *in, uint32 *out, const int cx, const int cy, const int cz)
+// Processes nRows rows as one stream of words, loading each word's left and right neighbors with
+// unaligned loads. The first and last words of each row are then recomputed, since their neighbors
+// outside the row are 0.
+template <uint32 row, bool dilate> void xPass(const uint32 *in, uint32 *out, const size_t wpl, const size_t nRows)
 {
-  const int wpl  = (cx>>5) + ((cx&0x1F)!=0);
-  const int ys = cy - 1;
-  uint32 *o = out;
-  uint32 *i = in;
-  for (int z=0;z<cz;z++)
+  const size_t nw = wpl*nRows;
+  size_t i=1;
+  for (;i+SW::width<nw;i+=SW::width)
+    SW::store(out+i,xVector<row,dilate>(SW::load(in+i-1),SW::load(in+i),SW::load(in+i+1)));
+  for (;i+1<nw;i++) out[i] = xWord<row,dilate>(in[i-1],in[i],in[i+1]);
+  for (size_t r=0;r<nRows;r++)
   {
-    for (int x=0;x<wpl;x++,o++,i++) o[0] = 0;
-    for (int y=1;y<ys;y++)
+    const uint32 *a = in + r*wpl;
+    uint32 *b = out + r*wpl;
+    if (wpl==1)
+      b[0] = xWord<row,dilate>(0,a[0],0);
+    else
     {
-      for (int x=0;x<wpl;x++,o++,i++)
-        o[0] = i[-wpl] & i[0] & i[wpl];
+      b[0] = xWord<row,dilate>(0,a[0],a[1]);
+      b[wpl-1] = xWord<row,dilate>(a[wpl-2],a[wpl-1],0);
     }
-    for (int x=0;x<wpl;x++,o++,i++) o[0] = 0;
   }
 }
 
-void Morph32::dilateY32(uint32 *in, uint32 *inB, uint32 *out, const int cx, const int cy, const int cz)
+// out = a op b op c over the inputs selected by sel (bits 0, 1 and 2), and the inputs in rest.
+template <class Op, uint32 sel, class... P>
+void combineSelected(uint32 *out, const size_t n, const uint32 *a, const uint32 *b, const uint32 *c, const P *... rest)
 {
-  const int wpl  = (cx>>5) + ((cx&0x1F)!=0);
-  const int ys = cy - 1;
-  uint32 *o = out;
-  uint32 *i = in;
-  uint32 *ib = inB;
-  for (int z=0;z<cz;z++)
+  if constexpr (sel==0)
   {
-    for (int x=0;x<wpl;x++,o++,i++,ib++) o[0] = i[0] | ib[wpl];
-    for (int y=1;y<ys;y++)
-    {
-      for (int x=0;x<wpl;x++,o++,i++,ib++)
-        o[0] = ib[-wpl] | i[0] | ib[wpl];
-    }
-    for (int x=0;x<wpl;x++,o++,i++,ib++) o[0] = ib[-wpl] | i[0];
+    if constexpr (sizeof...(P)>0) SW::combineAll<Op>(out,n,rest...); else std::fill(out,out+n,0);
   }
+  else if constexpr ((sel&1)!=0)
+    combineSelected<Op,(sel>>1)>(out,n,b,c,c,rest...,a);
+  else
+    combineSelected<Op,(sel>>1)>(out,n,b,c,c,rest...);
 }
 
-void Morph32::erodeY32(uint32 *in, uint32 *inB, uint32 *out, const int cx, const int cy, const int cz)
+// Combines the neighbors prev, cur and next selected by sel (bits 0, 1 and 2), and out itself when
+// accumulating. prev and next are null outside the volume, where voxels are 0: an erosion that
+// needs them is 0, and a dilation skips them.
+template <uint32 sel, bool dilate, bool accumulate>
+void combineNeighbors(uint32 *out, const size_t n, const uint32 *prev, const uint32 *cur, const uint32 *next)
 {
-  const int wpl  = (cx>>5) + ((cx&0x1F)!=0);
-  const int ys = cy - 1;
-  uint32 *o = out;
-  uint32 *i = in;
-  uint32 *ib= inB;
-  for (int z=0;z<cz;z++)
+  typedef OpFor<dilate> Op;
+  if (!dilate && ((((sel&1)!=0) && !prev) || (((sel&4)!=0) && !next)))
   {
-    for (int x=0;x<wpl;x++,o++) o[0] = 0;
-    i += wpl; ib += wpl;
-    for (int y=1;y<ys;y++)
-    {
-      for (int x=0;x<wpl;x++,o++,i++,ib++)
-        o[0] = ib[-wpl] & i[0] & ib[wpl];
-    }
-    for (int x=0;x<wpl;x++,o++) o[0] = 0;
-    i += wpl; ib += wpl;
+    std::fill(out,out+n,0);
+    return;
   }
-}
-
-bool Morph32::dilateC(uint32 *ina, uint32 *inb)
-{
-  const int sz = cz;
-  uint32 *a=ina, *b=inb;
-  for (int i=0;i<sz;i++)
+  const uint32 *acc = out;
+  if (prev && next)
   {
-    dilateX32(a,&sliceA[0],cx,cy);
-    dilateY32(&sliceA[0],b,cx,cy,1);
-    a += slicesize;
-    b += slicesize;
+    if constexpr (accumulate) combineSelected<Op,sel>(out,n,prev,cur,next,acc); else combineSelected<Op,sel>(out,n,prev,cur,next);
   }
-  b = inb;
-  for (int j=0;j<slicesize;j++)
+  else if (prev)
   {
-    sliceA[j] = b[j];  b[j] |= b[j+slicesize];
+    if constexpr (accumulate) combineSelected<Op,(sel&3)>(out,n,prev,cur,cur,acc); else combineSelected<Op,(sel&3)>(out,n,prev,cur,cur);
   }
-  b += slicesize;
-  for (int i=1;i<sz-1;i++)
+  else if (next)
   {
-    for (int j=0;j<slicesize;j++)
-    {
-      uint32 t = b[j];
-      b[j] |= sliceA[j] | b[j+slicesize];
-      sliceA[j] = t;
-    }
-    b += slicesize;
+    if constexpr (accumulate) combineSelected<Op,(sel&6)>(out,n,cur,cur,next,acc); else combineSelected<Op,(sel&6)>(out,n,cur,cur,next);
   }
-  for (int j=0;j<slicesize;j++)
+  else
   {
-    b[j] |= sliceA[j];
+    if constexpr (accumulate) combineSelected<Op,(sel&2)>(out,n,cur,cur,cur,acc); else combineSelected<Op,(sel&2)>(out,n,cur,cur,cur);
   }
-  return true;
 }
 
-bool Morph32::erodeC (uint32 *ina, uint32 *inb)
+// Y pass over the rows of one slice; rows selects the rows y-1, y and y+1, which are read from sm,
+// s0 and sp. out must not overlap the inputs.
+template <uint32 rows, bool dilate, bool accumulate>
+void yPass(const uint32 *sm, const uint32 *s0, const uint32 *sp, uint32 *out, const size_t wpl, const size_t cy)
 {
-  const int sz = cz;
-  uint32 *a=ina, *b=inb;
-  for (int i=0;i<sz;i++)
+  const size_t ss = wpl*cy;
+  if (cy<2)
   {
-    erodeX32(a,&sliceA[0],cx,cy);
-    erodeY32(&sliceA[0],b,cx,cy,1);
-    a += slicesize;
-    b += slicesize;
+    combineNeighbors<rows,dilate,accumulate>(out,ss,nullptr,s0,nullptr);
+    return;
   }
-  b = inb;
-  for (int j=0;j<slicesize;j++)
-  {
-    sliceA[j] = b[j];  b[j] = 0;
-  }
-  b += slicesize;
-  for (int i=1;i<sz-1;i++)
-  {
-    for (int j=0;j<slicesize;j++)
-    {
-      uint32 t = b[j];
-      b[j] &= sliceA[j] & b[j+slicesize];
-      sliceA[j] = t;
-    }
-    b += slicesize;
-  }
-  for (int j=0;j<slicesize;j++)
+  combineNeighbors<rows,dilate,accumulate>(out,wpl,nullptr,s0,sp+wpl);
+  combineNeighbors<rows,dilate,accumulate>(out+wpl,ss-2*wpl,sm,s0+wpl,sp+2*wpl);
+  combineNeighbors<rows,dilate,accumulate>(out+ss-wpl,wpl,sm+ss-2*wpl,s0+ss-wpl,nullptr);
+}
+}
+
+void Morph32::erodeX32(uint32 *in, uint32 *out, const int cx, const int n)
+{
+  xPass<7,false>(in,out,wordsPerLine(cx),n);
+}
+
+void Morph32::dilateX32(uint32 *in, uint32 *out, const int cx, const int n)
+{
+  xPass<7,true>(in,out,wordsPerLine(cx),n);
+}
+
+void Morph32::dilateY32(uint32 *in, uint32 *out, const int cx, const int cy, const int cz)
+{
+  const size_t ss = wordsPerLine(cx)*cy;
+  for (int z=0;z<cz;z++) yPass<7,true,false>(in+z*ss,in+z*ss,in+z*ss,out+z*ss,wordsPerLine(cx),cy);
+}
+
+void Morph32::erodeY32(uint32 *in, uint32 *out, const int cx, const int cy, const int cz)
+{
+  const size_t ss = wordsPerLine(cx)*cy;
+  for (int z=0;z<cz;z++) yPass<7,false,false>(in+z*ss,in+z*ss,in+z*ss,out+z*ss,wordsPerLine(cx),cy);
+}
+
+void Morph32::dilateY32(uint32 *in, uint32 *inB, uint32 *out, const int cx, const int cy, const int cz)
+{
+  const size_t ss = wordsPerLine(cx)*cy;
+  for (int z=0;z<cz;z++) yPass<7,true,false>(inB+z*ss,in+z*ss,inB+z*ss,out+z*ss,wordsPerLine(cx),cy);
+}
+
+void Morph32::erodeY32(uint32 *in, uint32 *inB, uint32 *out, const int cx, const int cy, const int cz)
+{
+  const size_t ss = wordsPerLine(cx)*cy;
+  for (int z=0;z<cz;z++) yPass<7,false,false>(inB+z*ss,in+z*ss,inB+z*ss,out+z*ss,wordsPerLine(cx),cy);
+}
+
+// Dilation in X can set the bit just beyond cx. Padded (VBit64) lines must keep their padding bits
+// at 0; VBit lines keep the original behavior.
+void Morph32::clearPadding(uint32 *slice)
+{
+  if (!paddedLines) return;
+  const size_t used = wordsPerLine(cx);
+  const uint32 lastMask = (cx&0x1F) ? (uint32(1)<<(cx&0x1F))-1 : 0xFFFFFFFF;
+  for (size_t y=0;y<cy;y++)
   {
-    b[j] = 0;
+    uint32 *row = slice + y*lineWords;
+    row[used-1] &= lastMask;
+    if (used<lineWords) row[used] = 0;
   }
-  return true;
 }
+
+int Morph32::threadCount() const
+{
+  return (nThreads>0) ? nThreads : SILT::ThreadControl::nThreads();
+}
+
 void Morph32::releaseMemory()
 {
-  cx=cy=cz=slicesize=0;
-  sliceA=std::vector<uint32>();
-  volA=std::vector<uint32>();
-  volB=std::vector<uint32>();
+  cx=cy=cz=slicesize=lineWords=0;
+  scratch=std::vector<uint32>();
 }
 
-void Morph32::init(int cx_, int cy_, int cz_)
+void Morph32::init(int cx_, int cy_, int cz_, const size_t lineWords_)
 {
   cx = cx_;
   cy = cy_;
   cz = cz_;
-  const int extra = (cx&0x1F);
-  const int wpl  = (cx>>5);
-  const int wx = wpl + (extra!=0);
-  if ((int)(wx*cy)!=slicesize)
-  {
-    slicesize = wx*cy;
-    sliceA.resize(slicesize); // refactor to be container or smart pointer
-    volA.resize(slicesize*cz);
-    volB.resize(slicesize*cz);
-  }
+  paddedLines = (lineWords_>0);
+  lineWords = paddedLines ? lineWords_ : wordsPerLine(cx);
+  slicesize = lineWords*cy;
 }
 
-bool Morph32::dilateR(uint32 *ina, uint32 *inb)
+// Saves the first and last depth input slices of each slab. When the operators work in place, a slab
+// may overwrite these before its neighbors have read them.
+void Morph32::saveSlabEdges(const uint32 *in, const int nt, const int depth)
 {
-  const int sz = cz;
-  uint32 *a = ina;
-  uint32 *b = inb;
-  for (int i=0;i<sz;i++)
+  const size_t n = slabSlices(depth)*slicesize*nt;
+  if (scratch.size()<n) scratch.resize(n);
+  SILT::parallelFor(cz,[&](const size_t z0, const size_t z1, const int slab)
+  {
+    const size_t n = std::min<size_t>(depth,z1-z0); // shorter only when there is a single slab
+    std::copy(in+z0*slicesize,in+(z0+n)*slicesize,scratchSlice(slab,depth,tempSlices+4*depth));
+    std::copy(in+(z1-n)*slicesize,in+z1*slicesize,scratchSlice(slab,depth,tempSlices+5*depth));
+  },minSlabSize(depth),nt);
+}
+
+//! \brief Streams one z-slab through a chain of operators.
+//! \details Stage k keeps a three-slice ring of its input slices. For elements whose nonempty planes
+//!          are all the same (e.g., the cube), the ring holds the in-plane filtered slices and the
+//!          output is a z combination of them; otherwise the ring holds the unfiltered slices and each
+//!          plane of the element is applied to its neighbor slice. When input slice z arrives, output
+//!          slice z-1 is computed and passed to stage k+1. The last stage writes the output volume.
+//!          Output slice z is written only after input slice z+depth has been read, so out may be in.
+//!          Each stage handles one more slice on each side of the slab than the next, which
+//!          reproduces the results of running the operators one at a time. Slices outside the volume
+//!          are treated as 0.
+struct Morph32::SlabPipeline {
+  typedef void (SlabPipeline::*PushFn)(const int k, const size_t z, const uint32 *src);
+  typedef void (SlabPipeline::*EmitFn)(const int k, const size_t z);
+  struct Kernel {
+    PushFn push;
+    EmitFn emit;
+  };
+  // dilation by an element is computed as the union of translates by its reflection
+  template <class SE, bool dilate> static Kernel kernel()
   {
-    dilateX32(a,&sliceA[0],cx,cy);
-    dilateY32(&sliceA[0],a,b,cx,cy,1);
-    a += slicesize;
-    b += slicesize;
+    typedef StructuringElement<dilate ? SE::reflected() : SE::mask> E;
+    return Kernel{&SlabPipeline::push<E,dilate>,&SlabPipeline::emit<E,dilate>};
   }
-  b = inb;
-  uint32 *c = ina + slicesize;
-  for (int j=0;j<slicesize;j++)
+  static Kernel kernel(const Operator op)
   {
-    b[j] |= c[j];
+    switch (op)
+    {
+      case ErodeC : return kernel<StructuringElements::Cube,false>();
+      case DilateC : return kernel<StructuringElements::Cube,true>();
+      case ErodeR : return kernel<StructuringElements::Cross,false>();
+      case DilateR : return kernel<StructuringElements::Cross,true>();
+      case ErodeB : return kernel<StructuringElements::Ball,false>();
+      case DilateB : return kernel<StructuringElements::Ball,true>();
+      case ErodeS : return kernel<StructuringElements::Square,false>();
+      case DilateS : return kernel<StructuringElements::Square,true>();
+    }
+    return kernel<StructuringElements::Cube,false>();
+  }
+  SlabPipeline(Morph32 &m, const std::vector<Operator> &ops, uint32 *out, const size_t z0, const size_t z1, const int slab) :
+    m(m), out(out), z0(z0), z1(z1), slab(slab), depth(int(ops.size()))
+  {
+    for (auto op : ops) kernels.push_back(kernel(op));
   }
-  b += slicesize;
-  c += slicesize;
-  a = ina;
-  for (int i=1;i<sz-1;i++)
+  uint32 *scratch(const int n) { return m.scratchSlice(slab,depth,n); }
+  uint32 *ring(const int k, const size_t z) { return scratch(tempSlices+4*k+int(z%3)); }
+  size_t first(const int k) const { return (z0>size_t(depth-k)) ? z0-(depth-k) : 0; } // first input slice of stage k
+  size_t last(const int k) const { return std::min<size_t>(m.cz,z1+(depth-k)); }      // end of the input slices of stage k
+  void run(const uint32 *in)
   {
-    for (int j=0;j<slicesize;j++)
+    for (size_t z=first(0);z<last(0);z++)
     {
-      b[j] |= a[j]|c[j];
+      const uint32 *src = in+z*m.slicesize;
+      if (z<z0) // saved last slices of the previous slab
+        src = m.scratchSlice(slab-1,depth,tempSlices+5*depth+int(z+depth-z0));
+      else if (z>=z1) // saved first slices of the next slab
+        src = m.scratchSlice(slab+1,depth,tempSlices+4*depth+int(z-z1));
+      (this->*kernels[0].push)(0,z,src);
     }
-    a += slicesize;
-    b += slicesize;
-    c += slicesize;
   }
-  for (int j=0;j<slicesize;j++)
+  // emits the output slices of stage k that input slice z completes
+  void advance(const int k, const size_t z)
   {
-    b[j] |= a[j];
+    if (z>first(k+1) && z-1<last(k+1)) (this->*kernels[k].emit)(k,z-1);
+    if (z+1==m.cz && z>=first(k+1) && z<last(k+1)) (this->*kernels[k].emit)(k,z);
   }
-  return true;
-}
-
-bool Morph32::erodeR (uint32 *ina, uint32 *inb)
-{
-  const int sz = cz;
-  uint32 *d = inb + slicesize*(sz-1);
-  for (int i=0;i<slicesize;i++) { inb[i]=0; d[i] = 0; }
-  uint32 *a = ina+slicesize;
-  uint32 *b = inb+slicesize;
-  for (int i=1;i<sz-1;i++)
+  template <uint32 row, bool dilate> const uint32 *xFiltered(const uint32 *src, const int n)
   {
-    erodeX32(a,&sliceA[0],cx,cy);
-    erodeY32(&sliceA[0],a,b,cx,cy,1);
-    a += slicesize;
-    b += slicesize;
+    uint32 *t = scratch(n);
+    xPass<row,dilate>(src,t,m.lineWords,m.cy);
+    if (dilate) m.clearPadding(t);
+    return t;
   }
-  a = ina;
-  b = inb;
-  uint32 *c = ina + slicesize*2;
-  b += slicesize;
-  // set first and last slice to 0.
-  for (int i=1;i<sz-1;i++)
+  // applies the in-plane part of an element, given as three row patterns; out must not overlap src
+  template <uint32 plane, bool dilate, bool accumulate> void planePass(const uint32 *src, uint32 *out)
   {
-    for (int j=0;j<slicesize;j++)
+    constexpr uint32 rm = plane&7, r0 = (plane>>3)&7, rp = (plane>>6)&7;
+    constexpr uint32 rows = (rm ? 1 : 0) | (r0 ? 2 : 0) | (rp ? 4 : 0);
+    const uint32 *sm = src, *s0 = src, *sp = src; // rows with only the center voxel use src
+    if constexpr (r0!=0 && r0!=2) s0 = xFiltered<r0,dilate>(src,0);
+    if constexpr (rm!=0 && rm!=2)
+    {
+      if constexpr (rm==r0) sm = s0; else sm = xFiltered<rm,dilate>(src,1);
+    }
+    if constexpr (rp!=0 && rp!=2)
     {
-      b[j] &= a[j]&c[j];
+      if constexpr (rp==r0) sp = s0; else if constexpr (rp==rm) sp = sm; else sp = xFiltered<rp,dilate>(src,2);
     }
-    a += slicesize;
-    b += slicesize;
-    c += slicesize;
+    yPass<rows,dilate,accumulate>(sm,s0,sp,out,m.lineWords,m.cy);
   }
-  return true;
-}
+  template <class SE, bool dilate> void push(const int k, const size_t z, const uint32 *src)
+  {
+    uint32 *r = ring(k,z);
+    if constexpr (SE::zSeparable())
+      planePass<SE::commonPlane(),dilate,false>(src,r);
+    else
+      std::copy(src,src+m.slicesize,r);
+    advance(k,z);
+  }
+  template <class SE, bool dilate> void emit(const int k, const size_t z)
+  {
+    const size_t ss = m.slicesize;
+    const uint32 *prev = (z>0) ? ring(k,z-1) : nullptr;
+    const uint32 *next = (z+1<m.cz) ? ring(k,z+1) : nullptr;
+    const uint32 *cur = ring(k,z);
+    uint32 *o = (k+1==depth) ? out + z*ss : scratch(tempSlices+4*k+3);
+    if constexpr (SE::zSeparable())
+      combineNeighbors<SE::planes(),dilate,false>(o,ss,prev,cur,next);
+    else
+    {
+      constexpr uint32 pm = SE::plane(-1), p0 = SE::plane(0), pp = SE::plane(1);
+      constexpr uint32 center = 0x10; // plane with only the center voxel
+      bool started = false;
+      if constexpr (p0!=0)
+      {
+        planePass<p0,dilate,false>(cur,o);
+        started = true;
+      }
+      if constexpr (pm==center && pp==center)
+      {
+        if (started) combineNeighbors<5,dilate,true>(o,ss,prev,o,next); else combineNeighbors<5,dilate,false>(o,ss,prev,cur,next);
+      }
+      else if (!dilate && ((pm && !prev) || (pp && !next)))
+        std::fill(o,o+ss,0);
+      else
+      {
+        if constexpr (pm!=0) if (prev)
+        {
+          if (started) planePass<pm,dilate,true>(prev,o); else planePass<pm,dilate,false>(prev,o);
+          started = true;
+        }
+        if constexpr (pp!=0) if (next)
+        {
+          if (started) planePass<pp,dilate,true>(next,o); else planePass<pp,dilate,false>(next,o);
+          started = true;
+        }
+        if (!started) std::fill(o,o+ss,0);
+      }
+    }
+    if (k+1<depth) (this->*kernels[k+1].push)(k+1,z,o);
+  }
+  Morph32 &m;
+  std::vector<Kernel> kernels;
+  uint32 *out;
+  const size_t z0, z1;
+  const int slab;
+  const int depth;
+};
 
-bool Morph32::dilateO2(uint32 *a, uint32 *b)
+bool Morph32::apply(const std::vector<Operator> &ops, const uint32 *in, uint32 *out)
 {
-  dilateR(   a,&volA[0]);
-  dilateR(&volA[0],&volB[0]);
-  dilateC(&volB[0],&volA[0]);
-  dilateC(&volA[0],   b);
+  if (ops.empty())
+  {
+    if (in!=out) std::copy(in,in+slicesize*cz,out);
+    return true;
+  }
+  const int nt = threadCount();
+  const int depth = int(ops.size());
+  saveSlabEdges(in,nt,depth);
+  SILT::parallelFor(cz,[&](const size_t z0, const size_t z1, const int slab)
+  {
+    SlabPipeline(*this,ops,out,z0,z1,slab).run(in);
+  },minSlabSize(depth),nt);
   return true;
 }
 
-bool Morph32::erodeO2(uint32 *a, uint32 *b)
-{
-  erodeR(       a,&volA[0]);
-  erodeR(&volA[0],&volB[0]);
-  erodeC(&volB[0],&volA[0]);
-  erodeC(&volA[0],   b);
-  return true;
-}
+bool Morph32::dilateC(uint32 *ina, uint32 *inb) { return apply({DilateC},ina,inb); }
+bool Morph32::erodeC (uint32 *ina, uint32 *inb) { return apply({ErodeC},ina,inb); }
+bool Morph32::dilateR(uint32 *ina, uint32 *inb) { return apply({DilateR},ina,inb); }
+bool Morph32::erodeR (uint32 *ina, uint32 *inb) { return apply({ErodeR},ina,inb); }
+bool Morph32::dilateO2(uint32 *a, uint32 *b) { return apply({DilateR,DilateR,DilateC,DilateC},a,b); }
+bool Morph32::erodeO2(uint32 *a, uint32 *b) { return apply({ErodeR,ErodeR,ErodeC,ErodeC},a,b); }
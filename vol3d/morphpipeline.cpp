@@ -0,0 +1,195 @@
+// Copyright (C) 2025 The Regents of the University of California
+//
+// Created by David W. Shattuck, Ph.D.
+//
+// This file is part of maskbackgroundnoise.
+//
+// maskbackgroundnoise is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, version 2.1.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+
+#include <DS/morphpipeline.h>
+#include <DS/parallelfor.h>
+#include <DS/timer.h>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+
+bool MorphPipeline::parse(const std::string &recipe)
+{
+  std::vector<Step> atoms;
+  std::istringstream istr(recipe);
+  std::string token;
+  while (std::getline(istr,token,','))
+  {
+    const auto first = token.find_first_not_of(" \t");
+    const auto last = token.find_last_not_of(" \t");
+    token = (first==std::string::npos) ? "" : token.substr(first,last-first+1);
+    std::vector<Morph32::Operator> ops;
+    if (token=="eC") ops = {Morph32::ErodeC};
+    else if (token=="eR") ops = {Morph32::ErodeR};
+    else if (token=="dC") ops = {Morph32::DilateC};
+    else if (token=="dR") ops = {Morph32::DilateR};
+    else if (token=="eB") ops = {Morph32::ErodeB};
+    else if (token=="dB") ops = {Morph32::DilateB};
+    else if (token=="eS") ops = {Morph32::ErodeS};
+    else if (token=="dS") ops = {Morph32::DilateS};
+    else if (token=="eO2") ops = {Morph32::ErodeR,Morph32::ErodeR,Morph32::ErodeC,Morph32::ErodeC};
+    else if (token=="dO2") ops = {Morph32::DilateR,Morph32::DilateR,Morph32::DilateC,Morph32::DilateC};
+    else if (token=="fg") { atoms.push_back(Step(SegmentFG,token)); continue; }
+    else if (token=="bg") { atoms.push_back(Step(SegmentBG,token)); continue; }
+    else if (token=="fill") { atoms.push_back(Step(FillHoles,token)); continue; }
+    else
+    {
+      std::cerr<<"error: unrecognized operation '"<<token<<"' in \""<<recipe<<"\""<<std::endl;
+      return false;
+    }
+    atoms.push_back(Step(Morphology,token));
+    atoms.back().ops = ops;
+  }
+  plan.clear();
+  for (auto &atom : atoms)
+  {
+    if (!plan.empty() && plan.back().type==atom.type)
+    {
+      if (atom.type==Morphology) // fuse with the preceding morphology step
+      {
+        plan.back().ops.insert(plan.back().ops.end(),atom.ops.begin(),atom.ops.end());
+        plan.back().label += "," + atom.label;
+      }
+      continue; // repeating a segmentation does not change the mask
+    }
+    plan.push_back(atom);
+  }
+  return true;
+}
+
+std::string MorphPipeline::describe() const
+{
+  std::ostringstream ostr;
+  for (size_t i=0;i<plan.size();i++)
+  {
+    if (i) ostr<<' ';
+    if (plan[i].type==Morphology)
+      ostr<<'['<<plan[i].label<<']';
+    else
+      ostr<<plan[i].label;
+  }
+  return ostr.str();
+}
+
+// Stage k of a fused sweep recomputes 2*(depth-k) slices that belong to the neighboring slabs, so the
+// extra work is about (depth+1)/slab of the total. Deep chains are split when that would exceed 1/4.
+size_t MorphPipeline::maxFusedDepth(const size_t cz, const int nThreads)
+{
+  if (nThreads<=1) return cz+1;
+  const size_t slab = cz/nThreads;
+  return (slab>=8) ? slab/4 - 1 : 1;
+}
+
+int MorphPipeline::cropMargin(const size_t first) const
+{
+  int nDilations = 0;
+  for (size_t i=first;i<plan.size();i++)
+    nDilations += int(std::count_if(plan[i].ops.begin(),plan[i].ops.end(),Morph32::isDilation));
+  return nDilations + 1;
+}
+
+template <class Bits> bool MorphPipeline::runStep(const Step &step, Vol3D<Bits> &v)
+{
+  Timer t;
+  t.start();
+  switch (step.type)
+  {
+    case Morphology :
+      {
+        const size_t maxDepth = maxFusedDepth(v.cz,SILT::ThreadControl::nThreads());
+        for (size_t i=0;i<step.ops.size();i+=maxDepth)
+        {
+          const auto end = step.ops.begin() + std::min(step.ops.size(),i+maxDepth);
+          if (!morph.apply(std::vector<Morph32::Operator>(step.ops.begin()+i,end),v)) return false;
+        }
+      }
+      break;
+    case SegmentFG :
+      if (seedMode==NoSeed || !segmentFromSeed(v))
+      {
+        if (seedMode!=NoSeed && verbose) std::cout<<"seed ("<<seed[0]<<","<<seed[1]<<","<<seed[2]<<") is background; keeping the largest component"<<std::endl;
+        rls.segmentFG(v);
+      }
+      break;
+    case SegmentBG :
+      rls.segmentBG(v);
+      break;
+    case FillHoles :
+      rls.fillHoles(v);
+      break;
+  }
+  t.stop();
+  if (verbose) std::cout<<step.label<<" : "<<t.elapsed()<<std::endl;
+  return true;
+}
+
+// The crop is chosen before the first step and again after each foreground segmentation, which
+// usually removes most of the thresholded noise. If a background segmentation fills the outside of
+// the crop, the remaining steps run on the full volume.
+template <class Bits> bool MorphPipeline::runT(Vol3D<Bits> &v)
+{
+  Vol3D<Bits> vCrop;
+  MaskCrop::Box box;
+  bool cropped = false;
+  seed[0] = (seedMode==CenterSeed) ? v.cx/2 : seedX;
+  seed[1] = (seedMode==CenterSeed) ? v.cy/2 : seedY;
+  seed[2] = (seedMode==CenterSeed) ? v.cz/2 : seedZ;
+  auto uncrop = [&](const bool outside)
+  {
+    rls.clearFrame();
+    cropped = false;
+    return MaskCrop::paste(v,vCrop,box,outside);
+  };
+  for (size_t i=0;i<plan.size();i++)
+  {
+    if (cropToForeground && (i==0 || plan[i-1].type==SegmentFG))
+    {
+      MaskCrop::Box fg = MaskCrop::boundingBox(cropped ? vCrop : v);
+      if (cropped && !fg.empty())
+      {
+        fg.x0 += box.x0; fg.x1 += box.x0;
+        fg.y0 += box.y0; fg.y1 += box.y0;
+        fg.z0 += box.z0; fg.z1 += box.z0;
+      }
+      const MaskCrop::Box b = MaskCrop::expand(fg,cropMargin(i),v.cx,v.cy,v.cz);
+      const bool useCrop = !b.empty() && b.size()<size_t(v.cx)*v.cy*v.cz && MaskCrop::connectedOutside(b,v.cx,v.cy,v.cz);
+      if (!useCrop)
+      {
+        if (cropped && !uncrop(false)) return false;
+      }
+      else if (!cropped || b.size()<box.size())
+      {
+        if (cropped && !uncrop(false)) return false;
+        box = b;
+        if (!MaskCrop::crop(vCrop,v,box)) return false;
+        rls.setFrame(box.x0,box.y0,box.z0,v.cx,v.cy,v.cz);
+        cropped = true;
+        if (verbose)
+          std::cout<<"crop : ["<<box.x0<<","<<box.x1<<")x["<<box.y0<<","<<box.y1<<")x["<<box.z0<<","<<box.z1<<")"<<std::endl;
+      }
+    }
+    if (!runStep(plan[i],cropped ? vCrop : v)) return false;
+    if (cropped && plan[i].type==SegmentBG && !rls.outsideSelected() && !uncrop(true)) return false;
+  }
+  return cropped ? uncrop(false) : true;
+}
+
+bool MorphPipeline::run(Vol3D<VBit> &v) { return runT(v); }
+bool MorphPipeline::run(Vol3D<VBit64> &v) { return runT(v); }
@@ -0,0 +1,87 @@
+// Copyright (C) 2025 The Regents of the University of California
+//
+// Created by David W. Shattuck, Ph.D.
+//
+// This file is part of maskbackgroundnoise.
+//
+// maskbackgroundnoise is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, version 2.1.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+
+#include <DS/overlappedreader.h>
+#include <DS/parallelfor.h>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace SILT {
+
+int OverlappedReader::nWorkers() const
+{
+  const int nt = (nThreads>0) ? nThreads : ThreadControl::nThreads();
+  return std::max(1,nt-1);
+}
+
+size_t OverlappedReader::read(izstream &ifile, char *dst, const size_t len, const size_t elementSize, const ChunkFn &process) const
+{
+  const size_t element = std::max(size_t(1),elementSize);
+  const size_t chunk = std::max(element,(std::min(chunkSize,size_t(1)<<30)/element)*element); // izstream reads at most 4GB
+  std::mutex mutex;
+  std::condition_variable ready;
+  size_t produced=0;   // bytes available in dst
+  size_t nextChunk=0;  // next chunk to be claimed by a worker
+  bool done=false;
+  auto work = [&](const int worker)
+  {
+    for (;;)
+    {
+      size_t first=0, last=0;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        ready.wait(lock,[&]() { return done || ((nextChunk+1)*chunk<=produced); });
+        first = nextChunk*chunk;
+        if (first>=produced) return; // done, and every chunk has been claimed
+        last = std::min(first+chunk,produced);
+        nextChunk++;
+      }
+      last -= (last-first)%element;
+      if (last>first) process(first,last,worker);
+    }
+  };
+  std::vector<std::thread> workers;
+  for (int i=0;i<nWorkers();i++) workers.emplace_back(work,i);
+  size_t total=0;
+  while (total<len)
+  {
+    const size_t request = std::min(chunk,len-total);
+    auto bytesRead = ifile.read(dst+total,unsigned(request));
+    if (bytesRead>0) total += size_t(bytesRead);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      produced = total;
+    }
+    ready.notify_all();
+    if (bytesRead != static_cast<decltype(bytesRead)>(request)) break;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    done = true;
+  }
+  ready.notify_all();
+  for (auto &t : workers) t.join();
+  return total;
+}
+
+} // end of namespace SILT
@@ -20,40 +20,63 @@
 //
 
 #include <DS/runlengthsegmenter.h>
-#include <graph.h>
+#include <DS/parallelfor.h>
 #include <algorithm>
 
-int graphFactor=10;
-
 RunLengthSegmenter::RunLengthSegmenter() :
 	mode(D6),
 	cx(0), cy(0), cz(0),
+	lineWords(0),
 	high(255), low(0),
 	datasize(0),
 	runcount(0),
 	nsymbols(0),
 	verbose(false),
+	nThreads(0),
 	NMax(0),
 	rlsPicked(-1),
+	background(false),
+	frameX0(0), frameY0(0), frameZ0(0),
+	frameCX(0), frameCY(0), frameCZ(0),
+	outsideRegion(-1),
 	ensureCentered(true)
 {
 }
 
+void RunLengthSegmenter::setFrame(const int x0, const int y0, const int z0, const int frameCX_, const int frameCY_, const int frameCZ_)
+{
+	frameX0 = x0;
+	frameY0 = y0;
+	frameZ0 = z0;
+	frameCX = frameCX_;
+	frameCY = frameCY_;
+	frameCZ = frameCZ_;
+}
+
+bool RunLengthSegmenter::outsideSelected() const
+{
+	if (outsideRegion<0) return false;
+	for (auto &r : regionInfo)
+		if (r.label==outsideRegion) return r.selected!=0;
+	return false;
+}
+
 RunLengthSegmenter::~RunLengthSegmenter()
 {
 }
 
-void RunLengthSegmenter::setup(const int cx_, const int cy_, const int cz_)
+void RunLengthSegmenter::setup(const int cx_, const int cy_, const int cz_, const int lineWords_)
 {
 	cx=cx_;
 	cy=cy_;
 	cz=cz_;
+	lineWords = (lineWords_>0) ? lineWords_ : wordsPerLine(cx);
 	nregions = 0;
 	high = 255;
 	low = 0;
 	runcount = 0;
 	datasize = cz * cx * cy;
-	runs.resize(datasize);
+	runs.clear(); // the encoders append the runs; the capacity is kept for the next volume
 	linestart.resize(cz*cy+1);
 }
 
@@ -66,29 +89,111 @@ void RunLengthSegmenter::segment(uint8 *imageIn, uint8 *imageOut, uint8 zero, ui
 	label(imageOut);
 }
 
-void RunLengthSegmenter::makeGraph()
+// Merges each run of line b with the runs of line a that it touches; with diagonal, runs that touch
+// only at a corner are merged too.
+template <class Sets> void RunLengthSegmenter::linkLines(Sets &sets, const int a, const int b, const bool diagonal)
 {
+	int runA = linestart[a];
+	int runB = linestart[b];
+	const int stopA = linestart[a+1];
+	const int stopB = linestart[b+1];
+	while ((runA<stopA)&&(runB<stopB))
+	{
+		if (diagonal ? runs[runA].neighbors(runs[runB]) : runs[runA].intersects(runs[runB]))
+			sets.unite(runA,runB);
+		const int endA = runs[runA].stop;
+		const int endB = runs[runB].stop;
+		if (endA<=endB) runA++;
+		if (endA>=endB) runB++;
+	}
+}
+
+// Merges the runs of a line with those of the touching lines in the previous slice.
+template <class Sets> void RunLengthSegmenter::linkPreviousSlice(Sets &sets, const int line)
+{
+	const int up = line - cy;
 	switch (mode)
 	{
 		case D18 :
-			makeGraph18();
+			linkLines(sets,up-1,line,false);
+			linkLines(sets,up,line,true);
 			break;
 		case D26 :
-			makeGraph26();
+			linkLines(sets,up-1,line,true);
+			linkLines(sets,up,line,true);
 			break;
-		case D6 : 
+		case D6 :
 		default:
-			makeGraph6();
+			linkLines(sets,up,line,false);
 			break;
 	}
 }
 
+// Merges the runs of slices [z0,z1). The first slice is linked to the previous slice only if linkFirst
+// is set. Since the first line of each slice (y==0) is not connected to anything above it (there
+// are no voxels for y<0), there is nothing to link for it.
+template <class Sets> void RunLengthSegmenter::linkSlab(Sets &sets, const int z0, const int z1, const bool linkFirst)
+{
+	for (int z=z0;z<z1;z++)
+		for (int y=1;y<cy;y++)
+		{
+			const int line = z*cy + y;
+			if (linestart[line+1]<=linestart[line]) continue; // the line is empty
+			if ((z>0)&&((z>z0)||linkFirst)) linkPreviousSlice(sets,line);
+			linkLines(sets,line-1,line,mode!=D6);
+		}
+}
+
+// Labels the runs. With several threads, each labels a z-slab, then the first slice of each slab is
+// linked to the last slice of the previous slab, with all threads merging into the same sets.
+void RunLengthSegmenter::makeGraph()
+{
+	const int nt = (nThreads>0) ? nThreads : SILT::ThreadControl::nThreads();
+	const size_t minSlab = 1 + (1<<16)/(size_t(lineWords)*cy+1);
+	map.resize(runcount+1);
+	newmap.resize(runcount+1);
+	if ((nt<=1)||(size_t(cz)<2*minSlab))
+	{
+		sets.reset(runcount+1);
+		linkSlab(sets,0,cz,true);
+		nsymbols = sets.makemap(&map[0]);
+	}
+	else
+	{
+		concurrentSets.reset(runcount+1);
+		std::vector<int> slabStart(nt,0);
+		const int nSlabs = SILT::parallelFor(cz,[&](const size_t z0, const size_t z1, const int slab)
+		{
+			slabStart[slab] = int(z0);
+			linkSlab(concurrentSets,int(z0),int(z1),false);
+		},minSlab,nt);
+		SILT::parallelFor(nSlabs-1,[&](const size_t b0, const size_t b1, const int)
+		{
+			for (size_t b=b0;b<b1;b++)
+			{
+				const int z = slabStart[b+1];
+				for (int y=1;y<cy;y++)
+				{
+					const int line = z*cy + y;
+					if (linestart[line+1]>linestart[line]) linkPreviousSlice(concurrentSets,line);
+				}
+			}
+		},1,nt);
+		nsymbols = concurrentSets.makemap(&map[0]);
+	}
+	if (verbose) std::cout<<"There are "<<nsymbols<<" symbols."<<std::endl;
+	population();
+	findmax();
+}
+
 void RunLengthSegmenter::encode(uint8 *buffer)
 {
 	const uint8 code=high;
+	background = (code==0);
 	int index = 0;
 	int state = 0;
 	runcount = 0;
+	runs.clear();
 	RunLength newRun;
 	int linecount = 0;
 	int *pLinestart = &linestart[0];
@@ -110,7 +215,7 @@ void RunLengthSegmenter::encode(uint8 *buffer)
 				{
 					newRun.stop = x-1;
 					state = 0;
-					runs[runcount++] = newRun;
+					runs.push_back(newRun); runcount++;
 				}
 			}
 			else
@@ -125,7 +230,7 @@ void RunLengthSegmenter::encode(uint8 *buffer)
 		if (state!=0) // terminate the code.
 		{
 			newRun.stop = cx - 1;
-			runs[runcount++] = newRun;
+			runs.push_back(newRun); runcount++;
 		}
 	}
 	pLinestart[linecount] = runcount;
@@ -151,6 +256,26 @@ int RunLengthSegmenter::presegmentFG(Vol3D<VBit> &v)
 	return rlsPicked;
 }
 
+int RunLengthSegmenter::presegmentBG(Vol3D<VBit64> &v)
+{
+	setup(v.cx,v.cy,v.cz,2*wordsPerLine64(v.cx));
+	runcount = 0;
+	encode32BG(v.raw32());
+	makeGraph();
+	return rlsPicked;
+}
+
+int RunLengthSegmenter::presegmentFG(Vol3D<VBit64> &v)
+{
+	setup(v.cx,v.cy,v.cz,2*wordsPerLine64(v.cx));
+	runcount = 0;
+	high = 255;
+	low = 0;
+	encode32FG(v.raw32());
+	makeGraph();
+	return rlsPicked;
+}
+
 int RunLengthSegmenter::segment32FG(unsigned int *imageIn, unsigned int *imageOut)
 {
 	runcount = 0;
@@ -215,59 +340,27 @@ void RunLengthSegmenter::segment32BG(uint8 *imageIn, unsigned int *imageOut)
 void RunLengthSegmenter::label32FG(unsigned int *imageOut)
 {
 	remap(newmap);
-	int index = 0;
-	int label = 0;
-	int linecount = 0;
-	const int extra = (cx&0x1F);
-	const int wordsPerLine  = (cx>>5);
-	const int wx = wordsPerLine + (extra!=0); // width of x
-	const int wsize = wx * cy * cz;
-	for (int d=0;d<wsize;d++) imageOut[d] = 0;
-	int *pLinestart = &linestart[0];	
-	for (int z=0;z<cz; z++)
-	{
-		for (int y=0; y<cy; y++)
-		{
-			const int first = pLinestart[linecount];
-			const int last  = pLinestart[++linecount];
-			for (int i=first; i<last; i++)
-			{
-				if (newmap[label]) // only need to label positives.
-				{
-					const int start = runs[i].start;
-					const int stop = runs[i].stop;
-					unsigned int *X = imageOut + index + (start>>5);
-					unsigned int val = 0;
-					int pos = start&0x1F;
-					for (int j=start; j<=stop; j++)
-					{	
-						val|=0x80000000;
-						if (((++pos) &= 0x1F)==0) { *X++ |= val; val=0;}
-						val>>=1;
-					}
-					if (pos) { *X |= (val>>(31-pos)); }
-				}
-				label++;
-			}
-			index += wx;			
-		}
-	}	
+	const size_t wsize = size_t(lineWords) * cy * cz;
+	for (size_t d=0;d<wsize;d++) imageOut[d] = 0;
+	toggleSelectedRuns(imageOut);
 }
 
 void RunLengthSegmenter::label32BG(unsigned int *imageOut)
 {
 	remap(newmap);
-	int *pLinestart = &linestart[0];
-	int index = 0;
-	int label = 0;
-	int linecount = 0;
+	setAll32(imageOut);
+	toggleSelectedRuns(imageOut);
+}
+
+void RunLengthSegmenter::setAll32(unsigned int *imageOut)
+{
 	const int extra = (cx&0x1F);
 	const int wordsPerLine  = (cx>>5);
-	const int wx = wordsPerLine + (extra!=0); // width of x
+	const int wx = lineWords; // width of x
 	int endwidth = 32 - extra; // extra bits in the code
 	unsigned int edgecode=0xFFFFFFFF;
 	edgecode>>=endwidth;
-	int d = 0;
+	size_t d = 0;
 	for (int z=0;z<cz;z++)
 	{
 		for (int y=0;y<cy;y++)
@@ -277,87 +370,31 @@ void RunLengthSegmenter::label32BG(unsigned int *imageOut)
 				imageOut[d++] = 0xFFFFFFFF;
 			}
 			if (extra>0) imageOut[d++] = edgecode;
+			for (int x=wordsPerLine+(extra>0);x<wx;x++) imageOut[d++] = 0; // padding
 		}
 	}
-	for (int z=0;z<cz; z++)
+}
+
+// Flips the bits of the runs whose regions were selected, a whole word at a time; the runs are set
+// in a cleared image for the foreground and cleared in a filled image for the background.
+void RunLengthSegmenter::toggleSelectedRuns(unsigned int *imageOut)
+{
+	const int nLines = cy*cz;
+	for (int line=0;line<nLines;line++)
 	{
-		for (int y=0; y<cy; y++)
+		unsigned int *row = imageOut + size_t(line)*lineWords;
+		const int last = linestart[line+1];
+		for (int i=linestart[line];i<last;i++)
 		{
-			int first = pLinestart[linecount];
-			int last  = pLinestart[++linecount];
-			for (int i=first; i<last; i++)
-			{
-				if (newmap[label]) // only need to label positives.
-				{
-					int start = runs[i].start;
-					int stop = runs[i].stop;
-					unsigned int *X = imageOut + index + (start>>5);
-					unsigned int val = 0;
-					int pos = start&0x1F;
-					for (int j=start; j<=stop; j++)
-					{	
-						val|=0x80000000;
-						if (((++pos) &= 0x1F)==0) { *X++ ^= val; val=0;}
-						val>>=1;
-					}
-					if (pos) { *X ^= (val>>(31-pos)); }
-				}
-				label++;
-			}
-			index += wx;			
+			if (newmap[i]) toggleRun32(row,runs[i].start,runs[i].stop); // only need to label positives.
 		}
 	}
 }
 
 void RunLengthSegmenter::encode32BG(unsigned int *imageIn)
 {
-	int state = 0;
-	runcount = 0;
-	RunLength newRun;
-	int linecount = 0;
-	int *pLinestart = &linestart[0];
-	unsigned int *cptr  = imageIn;
-	for (int z=0; z<cz; z++)
-	for (int y=0; y<cy; y++)
-	{
-		pLinestart[linecount++] = runcount;
-		unsigned int val = *(cptr++);
-		int p = 1;
-		int bit = (val & 1);
-		state = (bit==0); // grab the lowest bit
-		val >>=1;
-		if (state) newRun.start = 0;
-		for (int x=1;x<cx;x++)
-		{
-			if (p==0) { val = *(cptr++); }
-			(++p) &= 0x1F;			
-			int bit = (val & 1);		
-			if (bit!=0)
-			{
-				if (state!=0) // terminate a code
-				{
-					newRun.stop = x-1;
-					state = 0;
-					runs[runcount++] = newRun;
-				}
-			}
-			else
-			{
-				if (state==0) // start a New code
-				{
-					newRun.start = x;
-					state = 1;
-				}
-			}
-			val >>=1;  // shift the next one into place
-		}
-		if (state!=0) // terminate the code.
-		{
-			newRun.stop = cx - 1;
-			runs[runcount++] = newRun;
-		}
-	}
-	pLinestart[linecount] = runcount;
+	background = true;
+	encode32(imageIn,0xFFFFFFFF);
 }
 
 void RunLengthSegmenter::label(uint8 *buffOut)
@@ -398,139 +435,158 @@ inline int RunLengthSegmenter::intersect(RunLength& r1, RunLength& r2)
 
 int RunLengthSegmenter::labelID(const int xIn, const int yIn, const int zIn)
 {
-	const int start = linestart[zIn * cy + yIn ];
-	const int stop  = linestart[zIn * cy + yIn +1];
-	for (int i=start;i<stop;i++)
+	const int run = findRun(zIn*cy + yIn,xIn);
+	return (run<0) ? -1 : map[run];
+}
+
+// The runs of a line are sorted and disjoint, so both lookups are binary searches.
+int RunLengthSegmenter::firstRunReaching(const int line, const int x) const
+{
+	const auto first = runs.begin() + linestart[line];
+	const auto last = runs.begin() + linestart[line+1];
+	return int(std::lower_bound(first,last,x,[](const RunLength &r, const int x) { return r.stop<x; }) - runs.begin());
+}
+
+int RunLengthSegmenter::findRun(const int line, const int x) const
+{
+	const int run = firstRunReaching(line,x);
+	return ((run<linestart[line+1])&&(runs[run].start<=x)) ? run : -1;
+}
+
+// Adds a run of line (y,z) to the bounding box, count and coordinate sums of a region.
+void RunLengthSegmenter::addRun(RegionInfo &r, RegionSums &s, const int run, const int y, const int z) const
+{
+	const int start = runs[run].start;
+	const int stop = runs[run].stop;
+	const sint64 length = stop - start + 1;
+	if (r.count==0)
 	{
-		if ((xIn>=runs[i].start)&&(xIn<=runs[i].stop))
-		{
-			return map[i];
-		}
+		r.x0 = start; r.x1 = stop;
+		r.y0 = r.y1 = y;
+		r.z0 = r.z1 = z;
+	}
+	else
+	{
+		r.x0 = std::min(r.x0,start); r.x1 = std::max(r.x1,stop);
+		r.y0 = std::min(r.y0,y); r.y1 = std::max(r.y1,y);
+		r.z0 = std::min(r.z0,z); r.z1 = std::max(r.z1,z);
 	}
-	return -1;
+	auto squares = [](const double n) { return (n-1)*n*(2*n-1)/6; }; // 0 + 1 + ... + (n-1)^2
+	const sint64 sx = start * length + (length * (length - 1))/2;
+	r.count += length;
+	s.x += sx;
+	s.y += y * length;
+	s.z += z * length;
+	s.xx += squares(stop+1) - squares(start);
+	s.yy += double(y) * y * length;
+	s.zz += double(z) * z * length;
+	s.xy += double(y) * sx;
+	s.xz += double(z) * sx;
+	s.yz += double(y) * z * length;
+}
+
+// Converts the sums to the centroid and central moments, and moves the region into the frame.
+void RunLengthSegmenter::finishRegion(RegionInfo &r, const RegionSums &s) const
+{
+	if (r.count<=0) return;
+	const double n = double(r.count);
+	const double mx = s.x/n, my = s.y/n, mz = s.z/n;
+	r.sxx = s.xx/n - mx*mx;
+	r.syy = s.yy/n - my*my;
+	r.szz = s.zz/n - mz*mz;
+	r.sxy = s.xy/n - mx*my;
+	r.sxz = s.xz/n - mx*mz;
+	r.syz = s.yz/n - my*mz;
+	r.mx = mx + frameX0;
+	r.my = my + frameY0;
+	r.mz = mz + frameZ0;
+	r.cx = (s.x + sint64(frameX0) * r.count) / r.count;
+	r.cy = (s.y + sint64(frameY0) * r.count) / r.count;
+	r.cz = (s.z + sint64(frameZ0) * r.count) / r.count;
+	r.x0 += frameX0; r.x1 += frameX0;
+	r.y0 += frameY0; r.y1 += frameY0;
+	r.z0 += frameZ0; r.z1 += frameZ0;
+	const int fx = (frameCX>0) ? frameCX : cx;
+	const int fy = (frameCX>0) ? frameCY : cy;
+	const int fz = (frameCX>0) ? frameCZ : cz;
+	r.touchesBorder = (r.x0==0)||(r.y0==0)||(r.z0==0)||(r.x1==fx-1)||(r.y1==fy-1)||(r.z1==fz-1);
 }
 
+// Fills the statistics of every region in a single sweep over the runs.
 void RunLengthSegmenter::population()
 {
-	regionInfo.resize(nsymbols+1);
+	regionInfo.assign(nsymbols+1,RegionInfo());
 	nregions=nsymbols+1;
+	std::vector<RegionSums> sums(nsymbols+1);
 	RegionInfo *ri = &regionInfo[0];
-
-	int *pLinestart = &linestart[0];
-	for (int c=0;c<=nsymbols;c++) 
+	const int nLines = cy*cz;
+	for (int line=0;line<nLines;line++)
 	{
-		ri[c].count = 0;
-		ri[c].cx = 0;
-		ri[c].cy = 0;
-		ri[c].cz = 0;
-		ri[c].label = 0;
-		ri[c].selected = 0;
-  }
-  int label = 0;
-	int linecount = 0;
-	for (int z=0;z<cz; z++)
-	{
-		for (int y=0; y<cy; y++)
+		const int y = line % cy;
+		const int z = line / cy;
+		const int last = linestart[line+1];
+		for (int i=linestart[line];i<last;i++)
 		{
-			int first = pLinestart[linecount];
-			int last  = pLinestart[++linecount];
-			for (int i=first; i<last; i++)
+			if (map[i]<0)
 			{
-				int length = (runs[i].stop - runs[i].start) + 1;
-				if (length>0)
-				{
-					if (map[label]<0)
-					{
-						std::cerr<<"error: illegal code in segment map"<<std::endl;
-						return;
-					}
-					RegionInfo &r = ri[map[label]];
-					r.count += length;
-					r.cx += runs[i].start * length + (length * (length - 1))/2;
-					r.cy += y * length;
-					r.cz += z * length;
-					r.label = map[label];
-				}
-				label++;
-      }
+				std::cerr<<"error: illegal code in segment map"<<std::endl;
+				return;
+			}
+			addRun(ri[map[i]],sums[map[i]],i,y,z);
+			ri[map[i]].label = map[i];
 		}
 	}
+	outsideRegion = -1;
+	if ((frameCX>0)&&background) addOutside(ri,&sums[0]);
 	for (int c=0;c<=nsymbols;c++)
-		if (ri[c].count>0)
-		{
-			ri[c].cx /= ri[c].count;
-			ri[c].cy /= ri[c].count;
-			ri[c].cz /= ri[c].count;
-		}
+		finishRegion(ri[c],sums[c]);
 	std::sort(regionInfo.begin(),regionInfo.end(),RunLengthSegmenter::regionInfoGE);
 }
 
-void RunLengthSegmenter::makeGraph6()
+// Adds the voxels outside the frame to the background region that touches them. A voxel on a face
+// of the crop that is not at the border of the frame is in that region. The outside is the frame's
+// box less the crop's, so its sums are differences of sums over the two boxes.
+void RunLengthSegmenter::addOutside(RegionInfo *ri, RegionSums *sums)
 {
-	std::vector<int> &pLinestart(linestart);
-  int linecount = 0;
-  Graph graph(datasize/graphFactor);
-	graph.reset(runcount+1);
-	for (int z=0;z<cz; z++)
+	const bool lowX = frameX0>0, lowY = frameY0>0, lowZ = frameZ0>0;
+	const bool highX = frameX0+cx<frameCX, highY = frameY0+cy<frameCY, highZ = frameZ0+cz<frameCZ;
+	if (!(lowX||highX||lowY||highY||lowZ||highZ)) return;
+	const int x = (lowX||!highX) ? 0 : cx-1;
+	const int y = (lowX||highX||lowY||!highY) ? 0 : cy-1;
+	const int z = (lowX||highX||lowY||highY||lowZ) ? 0 : cz-1;
+	const int run = findRegion(x,y,z);
+	if (run<0) return;
+	outsideRegion = map[run];
+	auto sum = [](const sint64 a, const sint64 b) { return (b*(b-1) - a*(a-1))/2; }; // a + ... + (b-1)
+	auto squares = [](const double a, const double b) { return ((b-1)*b*(2*b-1) - (a-1)*a*(2*a-1))/6; }; // a^2 + ... + (b-1)^2
+	// the frame in the coordinates of the crop
+	const sint64 ax = -frameX0, ay = -frameY0, az = -frameZ0;
+	const sint64 bx = frameCX-frameX0, by = frameCY-frameY0, bz = frameCZ-frameZ0;
+	const sint64 nx = bx-ax, ny = by-ay, nz = bz-az;
+	RegionInfo &r = ri[outsideRegion];
+	RegionSums &s = sums[outsideRegion];
+	r.count += nx*ny*nz - sint64(cx)*cy*cz;
+	s.x += sum(ax,bx)*ny*nz - sum(0,cx)*cy*cz;
+	s.y += sum(ay,by)*nx*nz - sum(0,cy)*cx*cz;
+	s.z += sum(az,bz)*nx*ny - sum(0,cz)*cx*cy;
+	s.xx += squares(ax,bx)*ny*nz - squares(0,cx)*cy*cz;
+	s.yy += squares(ay,by)*nx*nz - squares(0,cy)*cx*cz;
+	s.zz += squares(az,bz)*nx*ny - squares(0,cz)*cx*cy;
+	s.xy += double(sum(ax,bx))*sum(ay,by)*nz - double(sum(0,cx))*sum(0,cy)*cz;
+	s.xz += double(sum(ax,bx))*sum(az,bz)*ny - double(sum(0,cx))*sum(0,cz)*cy;
+	s.yz += double(sum(ay,by))*sum(az,bz)*nx - double(sum(0,cy))*sum(0,cz)*cx;
+	// along each axis, the outside spans the frame unless the crop spans the frame along the others
+	auto extent = [](sint32 &lo, sint32 &hi, const sint64 a, const sint64 b, const sint64 n, const bool othersFull)
 	{
-// Since the first line of each slice (y==0) is not connected to anything 
-// above it (there are no voxels for (y<0), there is nothing to link.
-		linecount++;
-		for (int y=1; y<cy; y++)
-		{
-			int first  = pLinestart[linecount];
-			int runA   = pLinestart[linecount-1]; // previous
-			int prevline = linecount - cy;
-			int last   = pLinestart[linecount+1];
-			linecount++;
-			if (last<=first) continue;					// the line is empty
-			if (z>0)
-			{
-				int curr = first;
-				int upStart= pLinestart[prevline]; // previous slice
-				int upStop = pLinestart[prevline+1]; // previous slice
-				int up   = upStart;
-				for (;;)
-				{
-					if (up  >=upStop) break;
-					if (curr>=last  ) break;
-					if (intersect(runs[up],runs[curr]))
-					{
-							graph.link(up  ,curr);
-              graph.link(curr,up  );
-					}
-					int newUp   = up;
-					int newCurr = curr;
-					if (runs[up].stop<=runs[curr].stop) newUp++;
-					if (runs[up].stop>=runs[curr].stop) newCurr++;
-					up   = newUp;
-					curr = newCurr;
-				}
-			}
-			int runB = first;
-			for (;;)
-			{
-				if (runA>=first) break;
-				if (runB>=last ) break;
-				if (intersect(runs[runA],runs[runB]))
-				{
-					graph.link(runA,runB);
-          graph.link(runB,runA);
-				}
-				int newA = runA;
-				int newB = runB;
-				if (runs[runA].stop<=runs[runB].stop) newA++;
-				if (runs[runA].stop>=runs[runB].stop) newB++;
-				runA = newA;
-				runB = newB;
-			}
-		}
-	}
-	map.resize(runcount+1);
-	newmap.resize(runcount+1);
-	nsymbols = graph.makemap(&map[0]);
-	population();
-	findmax();
+		const sint64 first = (!othersFull||a<0) ? a : n;
+		const sint64 last = (!othersFull||b>n) ? b-1 : -1;
+		lo = sint32(std::min<sint64>(lo,first));
+		hi = sint32(std::max<sint64>(hi,last));
+	};
+	const bool fullX = !(lowX||highX), fullY = !(lowY||highY), fullZ = !(lowZ||highZ);
+	extent(r.x0,r.x1,ax,bx,cx,fullY&&fullZ);
+	extent(r.y0,r.y1,ay,by,cy,fullX&&fullZ);
+	extent(r.z0,r.z1,az,bz,cz,fullX&&fullY);
 }
 
 void RunLengthSegmenter::findmax()
@@ -540,12 +596,15 @@ void RunLengthSegmenter::findmax()
 	int region = 0;
 	if (ensureCentered&&(high!=0))
 	{
-    int xMin = cx/10;
-    int xMax = cx - xMin - 1;
-    int yMin = cy/10;
-    int yMax = cy - yMin - 1;
-    int zMin = cz/10;
-    int zMax = cz - zMin - 1;
+    const int fx = (frameCX>0) ? frameCX : cx;
+    const int fy = (frameCX>0) ? frameCY : cy;
+    const int fz = (frameCX>0) ? frameCZ : cz;
+    int xMin = fx/10;
+    int xMax = fx - xMin - 1;
+    int yMin = fy/10;
+    int yMax = fy - yMin - 1;
+    int zMin = fz/10;
+    int zMax = fz - zMin - 1;
     const size_t maxR = (regionInfo.size()>7) ? 7 : regionInfo.size(); // TODO: should change this from hard code (7) to a parameter.
 		for(size_t r=0;r<maxR;r++)
 		{
@@ -577,265 +636,178 @@ void RunLengthSegmenter::remap(std::vector<LabelType> &newMap)
 
 int RunLengthSegmenter::findRegion(const int x, const int y, const int z)
 {
-	int start = linestart[z*cy * y ];
-	int stop  = linestart[z*cy * y +1];
-	int term = -1;
-	for (int i=start; i<stop; i++)
+	return findRun(z*cy + y,x);
+}
+
+// Calls f(r, lineOfR) for each run r connected to the given run. The connections are those made by
+// linkSlab, followed in both directions.
+template <class F> void RunLengthSegmenter::forEachAdjacentRun(const int run, const int line, F &&f) const
+{
+	const int y = line % cy;
+	const int z = line / cy;
+	auto visit = [&](const int other, const bool diagonal)
 	{
-		if (runs[i].stop<x) continue;
-		if (runs[i].start>x) continue;
-		term = i;
-		break;
+		const int d = diagonal ? 1 : 0;
+		const int lo = runs[run].start - d;
+		const int hi = runs[run].stop + d;
+		const int last = linestart[other+1];
+		for (int i=firstRunReaching(other,lo);(i<last)&&(runs[i].start<=hi);i++) f(i,other);
+	};
+	const bool inPlaneDiagonal = (mode!=D6);
+	if (y>0) visit(line-1,inPlaneDiagonal);
+	if (y+1<cy) visit(line+1,inPlaneDiagonal);
+	// each line with y>0 links to line y of the previous slice, and for D18/D26 to line y-1
+	const bool sameY = (mode!=D6);
+	const bool previousY = (mode==D26);
+	if ((z>0)&&(y>0))
+	{
+		visit(line-cy,sameY);
+		if (mode!=D6) visit(line-cy-1,previousY);
+	}
+	if (z+1<cz)
+	{
+		if (y>0) visit(line+cy,sameY);
+		if ((mode!=D6)&&(y+1<cy)) visit(line+cy+1,previousY);
 	}
-	return term;
 }
 
-void RunLengthSegmenter::makeGraph26()
+size_t RunLengthSegmenter::segment32FGFromSeed(unsigned int *image, const int xIn, const int yIn, const int zIn)
 {
-	int linecount = 0;
-	int linkcount = 0;
-  Graph graph(datasize/graphFactor);
-	graph.reset(runcount+1);
-	std::vector<int> &pLinestart(linestart);
-	for (int z=0;z<cz; z++)
+	high = 255;
+	low = 0;
+	encode32FG(image);
+	const int x = xIn - frameX0;
+	const int y = yIn - frameY0;
+	const int z = zIn - frameZ0;
+	if ((x<0)||(x>=cx)||(y<0)||(y>=cy)||(z<0)||(z>=cz)) return 0;
+	const int seed = findRun(z*cy + y,x);
+	if (seed<0) return 0;
+	newmap.assign(runcount+1,0);
+	std::vector<std::pair<int,int> > pending(1,std::make_pair(seed,z*cy + y));
+	newmap[seed] = high;
+	RegionInfo r;
+	RegionSums sums;
+	while (!pending.empty())
 	{
-// Since the first line of each slice (y==0) is not connected to anything 
-// above it (there are no voxels for (y<0), there is nothing to link.
-		linecount++;
-		for (int y=1; y<cy; y++)
+		const int run = pending.back().first;
+		const int line = pending.back().second;
+		pending.pop_back();
+		addRun(r,sums,run,line % cy,line / cy);
+		forEachAdjacentRun(run,line,[&](const int other, const int otherLine)
 		{
-			int first  = pLinestart[linecount];
-			int runA   = pLinestart[linecount-1]; // previous
-			int prevline = linecount - cy;
-			int last   = pLinestart[linecount+1];
-			linecount++;
-			if (last<=first) continue;					// the line is empty
-			if (z>0) // check previous slice.
-			{
-				int curr = first;
-				{
-					int upStart= pLinestart[prevline-1]; // previous slice
-					int upStop = pLinestart[prevline  ]; // previous slice
-					int up   = upStart;
-					for (;;)
-					{
-						if (up  >=upStop) break;
-						if (curr>=last  ) break;
-						if (runs[up].neighbors(runs[curr]))
-						{
-								graph.link(up  ,curr);
-								graph.link(curr,up  );
-							linkcount++;
-						}
-						int newUp   = up;
-						int newCurr = curr;
-						if (runs[up].stop<=runs[curr].stop) newUp++;
-						if (runs[up].stop>=runs[curr].stop) newCurr++;
-						up   = newUp;
-						curr = newCurr;
-					}
-				}
-				curr = first;
-				{
-					int upStart= pLinestart[prevline]; // previous slice
-					int upStop = pLinestart[prevline+1]; // previous slice
-					int up   = upStart;
-					for (;;)
-					{
-						if (up  >=upStop) break;
-						if (curr>=last  ) break;
-						if (runs[up].neighbors(runs[curr]))
-						{
-								graph.link(up  ,curr);
-								graph.link(curr,up  );
-							linkcount++;
-						}
-						int newUp   = up;
-						int newCurr = curr;
-						if (runs[up].stop<=runs[curr].stop) newUp++;
-						if (runs[up].stop>=runs[curr].stop) newCurr++;
-						up   = newUp;
-						curr = newCurr;
-					}
-				}
-			}
-			int runB = first;
-			for (;;)
-			{
-				if (runA>=first) break;
-				if (runB>=last ) break;
-				if (runs[runA].neighbors(runs[runB]))
-				{
-					graph.link(runA,runB);
-					graph.link(runB,runA);
-					linkcount++;
-				}
-				int newA = runA;
-				int newB = runB;
-				if (runs[runA].stop<=runs[runB].stop) newA++;
-				if (runs[runA].stop>=runs[runB].stop) newB++;
-				runA = newA;
-				runB = newB;
-			}
-		}
+			if (newmap[other]) return;
+			newmap[other] = high;
+			pending.push_back(std::make_pair(other,otherLine));
+		});
 	}
+	r.label = 1;
+	r.selected = 1;
+	finishRegion(r,sums);
+	regionInfo.assign(1,r);
+	nsymbols = 1;
+	nregions = 1;
+	rlsPicked = 0;
+	outsideRegion = -1;
 	map.resize(runcount+1);
-	newmap.resize(runcount+1);
-	nsymbols = graph.makemap(&map[0]);
-	if (verbose) std::cout<<"There are "<<nsymbols<<" symbols."<<std::endl;
-	population();
-	findmax();
+	for (int i=0;i<=runcount;i++) map[i] = newmap[i] ? 1 : 0;
+	const size_t wsize = size_t(lineWords) * cy * cz;
+	for (size_t d=0;d<wsize;d++) image[d] = 0;
+	toggleSelectedRuns(image);
+	return size_t(r.count);
 }
 
-void RunLengthSegmenter::makeGraph18()
+int RunLengthSegmenter::keep32FG(unsigned int *image, const sint64 minVoxels)
 {
-	int linecount = 0;
-	int linkcount = 0;
-  Graph graph(datasize/graphFactor);
-	graph.reset(runcount+1);
-	std::vector<int> &pLinestart(linestart);
-	for (int z=0;z<cz; z++)
+	high = 255;
+	low = 0;
+	encode32FG(image);
+	makeGraph();
+	int kept = 0;
+	for (auto &r : regionInfo)
 	{
-// Since the first line of each slice (y==0) is not connected to anything 
-// above it (there are no voxels for (y<0), there is nothing to link.
-		linecount++;
-		for (int y=1; y<cy; y++)
-		{
-			int first  = pLinestart[linecount];
-			int runA   = pLinestart[linecount-1]; // previous
-			int prevline = linecount - cy;
-			int last   = pLinestart[linecount+1];
-			linecount++;
-			if (last<=first) continue;					// the line is empty
-			if (z>0) // check previous slice.
-			{
-				int curr = first;
-				{
-					int upStart= pLinestart[prevline-1]; // previous slice
-					int upStop = pLinestart[prevline  ]; // previous slice
-					int up   = upStart;
-					for (;;)
-					{
-						if (up  >=upStop) break;
-						if (curr>=last  ) break;
-						if (runs[up].intersects(runs[curr]))
-						{
-								graph.link(up  ,curr);
-								graph.link(curr,up  );
-							linkcount++;
-						}
-						int newUp   = up;
-						int newCurr = curr;
-						if (runs[up].stop<=runs[curr].stop) newUp++;
-						if (runs[up].stop>=runs[curr].stop) newCurr++;
-						up   = newUp;
-						curr = newCurr;
-					}
-				}
-				curr = first;
-				{
-					int upStart= pLinestart[prevline]; // previous slice
-					int upStop = pLinestart[prevline+1]; // previous slice
-					int up   = upStart;
-					for (;;)
-					{
-						if (up  >=upStop) break;
-						if (curr>=last  ) break;
-						if (runs[up].neighbors(runs[curr]))
-						{
-								graph.link(up  ,curr);
-								graph.link(curr,up  );
-							linkcount++;
-						}
-						int newUp   = up;
-						int newCurr = curr;
-						if (runs[up].stop<=runs[curr].stop) newUp++;
-						if (runs[up].stop>=runs[curr].stop) newCurr++;
-						up   = newUp;
-						curr = newCurr;
-					}
-				}
-			}
-			int runB = first;
-			for (;;)
-			{
-				if (runA>=first) break;
-				if (runB>=last ) break;
-				if (runs[runA].neighbors(runs[runB]))
-				{
-					graph.link(runA,runB);
-					graph.link(runB,runA);
-					linkcount++;
-				}
-				int newA = runA;
-				int newB = runB;
-				if (runs[runA].stop<=runs[runB].stop) newA++;
-				if (runs[runA].stop>=runs[runB].stop) newB++;
-				runA = newA;
-				runB = newB;
-			}
-		}
+		r.selected = (r.count>minVoxels) ? 1 : 0;
+		kept += r.selected;
 	}
-	map.resize(runcount+1);
-	newmap.resize(runcount+1);
-	nsymbols = graph.makemap(&map[0]);
-	if (verbose) std::cout<<"There are "<<nsymbols<<" symbols."<<std::endl;
-	population();
-	findmax();
+	label32FG(image);
+	return kept;
+}
+
+bool RunLengthSegmenter::labelVolume(Vol3D<sint32> &labels) const
+{
+	if (!labels.setsize(cx,cy,cz)) return false;
+	std::vector<sint32> rank(nsymbols+1,0);
+	for (size_t i=0;i<regionInfo.size();i++)
+		if (regionInfo[i].count>0) rank[regionInfo[i].label] = sint32(i+1);
+	sint32 *out = labels.start();
+	const int nLines = cy*cz;
+	for (int line=0;line<nLines;line++)
+	{
+		sint32 *row = out + size_t(line)*cx;
+		for (size_t d=0;d<size_t(cx);d++) row[d] = 0;
+		const int last = linestart[line+1];
+		for (int i=linestart[line];i<last;i++)
+			std::fill(row+runs[i].start,row+runs[i].stop+1,rank[map[i]]);
+	}
+	return true;
+}
+
+// Marks the background runs reached from the faces, then sets everything else. Every run of the
+// first and last lines and slices, and every run that starts or ends at an x face, is a seed.
+size_t RunLengthSegmenter::fillHoles32(unsigned int *image)
+{
+	encode32BG(image);
+	newmap.assign(runcount+1,0);
+	std::vector<std::pair<int,int> > pending;
+	auto reach = [&](const int run, const int line)
+	{
+		if (newmap[run]) return;
+		newmap[run] = 1;
+		pending.push_back(std::make_pair(run,line));
+	};
+	const int nLines = cy*cz;
+	for (int line=0;line<nLines;line++)
+	{
+		const int y = line % cy;
+		const int z = line / cy;
+		const bool face = (y==0)||(y==cy-1)||(z==0)||(z==cz-1);
+		const int last = linestart[line+1];
+		for (int i=linestart[line];i<last;i++)
+			if (face||(runs[i].start==0)||(runs[i].stop==cx-1)) reach(i,line);
+	}
+	while (!pending.empty())
+	{
+		const int run = pending.back().first;
+		const int line = pending.back().second;
+		pending.pop_back();
+		forEachAdjacentRun(run,line,reach);
+	}
+	size_t filled = 0;
+	for (int i=0;i<runcount;i++)
+		if (!newmap[i]) filled += runs[i].stop - runs[i].start + 1;
+	if (filled>0)
+	{
+		setAll32(image);
+		toggleSelectedRuns(image);
+	}
+	return filled;
 }
 
 void RunLengthSegmenter::encode32FG(unsigned int *imageIn)
 {
-	const uint8 code=high;
-	int state = 0;
-	runcount = 0;
-	RunLength newRun;
-	int linecount = 0;
-	unsigned int *cptr = imageIn;
-	std::vector<int> &pLinestart(linestart);
-	for (int z=0; z<cz; z++)
+	background = false;
+	encode32(imageIn,0);
+}
+
+// Encodes the runs of set bits of each line after xor-ing its words with invert.
+void RunLengthSegmenter::encode32(const unsigned int *imageIn, const unsigned int invert)
+{
+	runs.clear();
+	const int nLines = cy*cz;
+	for (int line=0;line<nLines;line++)
 	{
-		for (int y=0; y<cy; y++)
-		{
-			pLinestart[linecount++] = runcount;
-			state = (*cptr)&1;		// equiv to (imageIn[index]==code);
-			if (state)
-			{
-				newRun.start = 0;
-			}
-			unsigned int val=0;
-			int p = 0;
-			for (int x=0;x<cx;x++)
-			{
-				if (p==0) { val = *(cptr++); }
-				(++p) &= 0x1F;
-        uint8 lowbit = 0xFF * (val & 1);	// grab the lowest bit
-				val >>=1;													// shift the next one into place				
-				if (x==0) continue;
-        if (lowbit!=code)
-				{
-					if (state!=0) // terminate a code
-					{
-						newRun.stop = x-1;
-						state = 0;
-						runs[runcount++] = newRun;
-					}
-				}
-				else
-				{
-					if (state==0) // start a New code
-					{
-						newRun.start = x;
-						state = 1;
-					}
-				}
-			}
-			if (state!=0) // terminate the code.
-			{
-				newRun.stop = cx - 1;
-				runs[runcount++] = newRun;
-			}
-		}
+		linestart[line] = int(runs.size());
+		appendRuns32(runs,imageIn + size_t(line)*lineWords,cx,invert);
 	}
-	pLinestart[linecount] = runcount;
+	runcount = int(runs.size());
+	linestart[nLines] = runcount;
 }
@@ -0,0 +1,215 @@
+// Copyright (C) 2025 The Regents of the University of California
+//
+// Created by David W. Shattuck, Ph.D.
+//
+// This file is part of maskbackgroundnoise.
+//
+// maskbackgroundnoise is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public License
+// as published by the Free Software Foundation, version 2.1.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+//
+
+
+#include <DS/runmask.h>
+#include <DS/structuringelement.h>
+#include <algorithm>
+
+namespace {
+// x offsets selected by a row of a structuring element: bits 0, 1 and 2 select dx = -1, 0 and 1
+inline int rowMin(const unsigned int row) { return (row&1) ? -1 : (row&2) ? 0 : 1; }
+inline int rowMax(const unsigned int row) { return (row&4) ? 1 : (row&2) ? 0 : -1; }
+inline bool rowContiguous(const unsigned int row) { return row!=5; }
+
+// out = a intersected with b; both are sorted, disjoint runs
+void intersectRuns(std::vector<RunLength> &out, const RunLength *a, const RunLength *aEnd, const RunLength *b, const RunLength *bEnd)
+{
+  out.clear();
+  while ((a<aEnd)&&(b<bEnd))
+  {
+    const int start = std::max(a->start,b->start);
+    const int stop = std::min(a->stop,b->stop);
+    if (start<=stop) out.push_back(RunLength(start,stop));
+    if (a->stop<b->stop) a++; else b++;
+  }
+}
+} // end anonymous namespace
+
+bool RunMask::encode32(const int cx_, const int cy_, const int cz_, const uint32 *words, const size_t lineWords)
+{
+  cx = cx_;
+  cy = cy_;
+  cz = cz_;
+  buildLines([&](Runs &out, const size_t line, Scratch &)
+  {
+    appendRuns32(out,words + line*lineWords,cx,0);
+  });
+  return true;
+}
+
+void RunMask::decode32(uint32 *words, const size_t lineWords) const
+{
+  const size_t nLines = size_t(cy)*cz;
+  SILT::parallelFor(nLines,[&](const size_t first, const size_t last, const int)
+  {
+    for (size_t line=first;line<last;line++)
+    {
+      uint32 *row = words + line*lineWords;
+      std::fill(row,row+lineWords,0);
+      for (size_t i=linestart[line];i<linestart[line+1];i++) toggleRun32(row,runs[i].start,runs[i].stop);
+    }
+  },256,nThreads);
+}
+
+bool RunMask::decode(Vol3D<VBit> &v) const
+{
+  if (((v.cx!=size_t(cx))||(v.cy!=size_t(cy))||(v.cz!=size_t(cz)))&&!v.setsize(cx,cy,cz)) return false;
+  decode32(v.raw32(),wordsPerLine(cx));
+  return true;
+}
+
+bool RunMask::decode(Vol3D<VBit64> &v) const
+{
+  if (((v.cx!=size_t(cx))||(v.cy!=size_t(cy))||(v.cz!=size_t(cz)))&&!v.setsize(cx,cy,cz)) return false;
+  decode32(v.raw32(),2*wordsPerLine64(cx));
+  return true;
+}
+
+sint64 RunMask::count() const
+{
+  sint64 n = 0;
+  for (auto &r : runs) n += r.stop - r.start + 1;
+  return n;
+}
+
+// Dilation: voxel (x,y,z) is set if (x-dx,y-dy,z-dz) is set for some offset of the element, so line
+// (y,z) is the union of the runs of line (y-dy,z-dz) shifted by each dx of row (dy,dz).
+template <unsigned int element> void RunMask::dilateLine(Runs &out, const int y, const int z, Scratch &buffers) const
+{
+  typedef StructuringElement<element> SE;
+  Runs &scratch = buffers.a;
+  scratch.clear();
+  for (int dz=-1;dz<=1;dz++)
+  {
+    const int sz = z - dz;
+    if ((sz<0)||(sz>=cz)) continue;
+    for (int dy=-1;dy<=1;dy++)
+    {
+      const int sy = y - dy;
+      const unsigned int row = SE::row(dy,dz);
+      if (!row||(sy<0)||(sy>=cy)) continue;
+      const size_t line = size_t(sz)*cy + sy;
+      const int lo = rowMin(row), hi = rowMax(row);
+      for (size_t i=linestart[line];i<linestart[line+1];i++)
+      {
+        if (rowContiguous(row))
+          scratch.push_back(RunLength(std::max(runs[i].start+lo,0),std::min(runs[i].stop+hi,cx-1)));
+        else
+        {
+          scratch.push_back(RunLength(std::max(runs[i].start+lo,0),runs[i].stop+lo));
+          scratch.push_back(RunLength(runs[i].start+hi,std::min(runs[i].stop+hi,cx-1)));
+        }
+      }
+    }
+  }
+  std::sort(scratch.begin(),scratch.end(),[](const RunLength &a, const RunLength &b) { return a.start<b.start; });
+  const size_t first = out.size();
+  for (auto &r : scratch)
+  {
+    if (r.start>r.stop) continue;
+    if ((out.size()>first)&&(r.start<=out.back().stop+1))
+      out.back().stop = std::max(out.back().stop,r.stop);
+    else
+      out.push_back(r);
+  }
+}
+
+// Erosion: voxel (x,y,z) is set if (x+dx,y+dy,z+dz) is set for every offset of the element, so line
+// (y,z) is the intersection over the rows (dy,dz) of the runs of line (y+dy,z+dz) narrowed by the row.
+// A row of contiguous offsets narrows each run on its own; the row {-1,1} intersects two shifted copies.
+template <unsigned int element> void RunMask::erodeLine(Runs &out, const int y, const int z, Scratch &scratch) const
+{
+  typedef StructuringElement<element> SE;
+  Runs &result = scratch.a, &rowRuns = scratch.b, &shiftLo = scratch.c, &shiftHi = scratch.d;
+  result.clear();
+  bool first = true;
+  for (int dz=-1;dz<=1;dz++)
+    for (int dy=-1;dy<=1;dy++)
+    {
+      const unsigned int row = SE::row(dy,dz);
+      if (!row) continue;
+      const int sy = y + dy, sz = z + dz;
+      if ((sy<0)||(sy>=cy)||(sz<0)||(sz>=cz)) return; // a required neighbor is outside the volume
+      const size_t line = size_t(sz)*cy + sy;
+      const int lo = rowMin(row), hi = rowMax(row);
+      rowRuns.clear();
+      if (rowContiguous(row))
+      {
+        for (size_t i=linestart[line];i<linestart[line+1];i++)
+          rowRuns.push_back(RunLength(runs[i].start-lo,runs[i].stop-hi));
+      }
+      else
+      {
+        shiftLo.clear();
+        shiftHi.clear();
+        for (size_t i=linestart[line];i<linestart[line+1];i++)
+        {
+          shiftLo.push_back(RunLength(runs[i].start-lo,runs[i].stop-lo));
+          shiftHi.push_back(RunLength(runs[i].start-hi,runs[i].stop-hi));
+        }
+        intersectRuns(rowRuns,shiftLo.data(),shiftLo.data()+shiftLo.size(),shiftHi.data(),shiftHi.data()+shiftHi.size());
+      }
+      for (auto &r : rowRuns) { r.start = std::max(r.start,0); r.stop = std::min(r.stop,cx-1); }
+      rowRuns.erase(std::remove_if(rowRuns.begin(),rowRuns.end(),[](const RunLength &r) { return r.start>r.stop; }),rowRuns.end());
+      if (first) result.swap(rowRuns);
+      else
+      {
+        intersectRuns(shiftLo,result.data(),result.data()+result.size(),rowRuns.data(),rowRuns.data()+rowRuns.size());
+        result.swap(shiftLo);
+      }
+      first = false;
+      if (result.empty()) return;
+    }
+  out.insert(out.end(),result.begin(),result.end());
+}
+
+template <unsigned int element, bool dilate> void RunMask::morph()
+{
+  buildLines([&](Runs &out, const size_t line, Scratch &scratch)
+  {
+    const int y = int(line % cy), z = int(line / cy);
+    if (dilate) dilateLine<element>(out,y,z,scratch);
+    else erodeLine<element>(out,y,z,scratch);
+  });
+}
+
+bool RunMask::apply(const std::vector<Morph32::Operator> &ops)
+{
+  using namespace StructuringElements;
+  for (auto op : ops)
+  {
+    switch (op)
+    {
+      case Morph32::ErodeC : morph<cubeMask,false>(); break;
+      case Morph32::DilateC : morph<cubeMask,true>(); break;
+      case Morph32::ErodeR : morph<crossMask,false>(); break;
+      case Morph32::DilateR : morph<crossMask,true>(); break;
+      case Morph32::ErodeB : morph<ballMask,false>(); break;
+      case Morph32::DilateB : morph<ballMask,true>(); break;
+      case Morph32::ErodeS : morph<squareMask,false>(); break;
+      case Morph32::DilateS : morph<squareMask,true>(); break;
+      default:
+        std::cerr<<"RunMask: unsupported operator "<<int(op)<<std::endl;
+        return false;
+    }
+  }
+  return true;
+}
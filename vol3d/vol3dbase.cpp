@@ -20,8 +20,12 @@
 
 #include <vol3dreorder.h>
 #include <vol3dbase.h>
+#include <DS/gzindex.h>
 
 bool Vol3DBase::noRotate=false; // set to TRUE to block all auto-rotation
+int Vol3DBase::compressionLevel=6; // 1 is fastest, 9 is smallest
+bool Vol3DBase::memoryMap=false;
+size_t Vol3DBase::gzIndexSpan=SILT::GZIndex::defaultSpan;
 
 Vol3DBase::Vol3DBase() : cx(0), cy(0), cz(0), rx(1), ry(1), rz(1),
   fileOrientation(SILT::Mat3<float32>::Identity),
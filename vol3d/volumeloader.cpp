@@ -100,7 +100,21 @@ std::unique_ptr<Vol3DBase> VolumeLoader::load(std::string ifname)
       return nullptr;
   }
   if (!volume) return nullptr;
+  bool rescaledWhileReading=false;
+  if (vq.datatype==SILT::Float32) // rescale each chunk as it arrives instead of in a separate pass
+  {
+    auto *vf = static_cast<Vol3D<float32> *>(volume.get());
+    rescaledWhileReading = true;
+    vf->readProcessor = [vf](float32 *first, float32 *last, const int)
+    {
+      const float32 slope = vf->scl_slope;
+      const float32 inter = vf->scl_inter;
+      if (((slope==1)&&(inter==0)) || !(std::abs(slope)>0)) return;
+      for (float32 *p=first;p<last;p++) *p = slope*(*p)+inter;
+    };
+  }
   if (volume) volume->read(vq,Vol3DBase::RotateToRAS);
+  if (rescaledWhileReading) static_cast<Vol3D<float32> *>(volume.get())->readProcessor = nullptr;
   if ((volume->scl_slope==1)&&(volume->scl_inter==0))
   {
 //    std::cout<<"no scale"<<std::endl;
@@ -113,7 +127,13 @@ std::unique_ptr<Vol3DBase> VolumeLoader::load(std::string ifname)
       switch (volume->typeID())
       {
         case SILT::Float32:
-          Vol3DBase::rescaleInPlace(static_cast<Vol3D<float32> *>(volume.get()));
+          if (rescaledWhileReading)
+          {
+            volume->scl_slope=1.0f;
+            volume->scl_inter=0.0f;
+          }
+          else
+            Vol3DBase::rescaleInPlace(static_cast<Vol3D<float32> *>(volume.get()));
           break;
         case SILT::Float64:
           Vol3DBase::rescaleInPlace(static_cast<Vol3D<float64> *>(volume.get()));
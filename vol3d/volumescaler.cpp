@@ -19,6 +19,7 @@
 //
 
 #include <volumescaler.h>
+#include <vol3dquantile.h>
 #include <algorithm>
 #include <vector>
 
@@ -51,14 +52,9 @@ template <class FloatT>
 double VolumeScaler::scaleToUint8_16bit(Vol3D<uint8> &vb, const Vol3D<FloatT> &vf)
 // assumes equivalent of 16-bit range of values stored in float, e.g., a uint16 file was saved as float
 {
-  std::vector<int> hgram(65536);
-  for (int i=0;i<65536;i++) hgram[i] = 0;
   const int ds = vf.size();
-  for (int i=0;i<ds;i++) hgram[u16clamp(vf[i])]++;
-  int limit = (int)(ds * 0.999);
-  int maxval = 65536;
-  int sum = 0;
-  for (int i=0;i<65536;i++) { if ((sum+=hgram[i])>limit) { maxval = i; break; } }
+  const size_t limit = (size_t)(ds * 0.999);
+  int maxval = u16clamp(Vol3DQuantile::nthValue(vf,limit)); // u16clamp is monotonic, so this is the 99.9th percentile of the clamped values
   vb.makeCompatible(vf);
   uint8 *d = vb.start();
   if (maxval==0)
@@ -82,14 +78,9 @@ double VolumeScaler::scaleToUint8(Vol3D<uint8> &vb, const Vol3D<float32> &vf)
   if (maxValue>0)
   {
     const float32 scale = 65535/(maxValue);
-    std::vector<int> hgram(65536);
-    for (int i=0;i<65536;i++) hgram[i] = 0;
     const int ds = vf.size();
-    for (int i=0;i<ds;i++) hgram[u16clamp(vf[i]*scale)]++;
-    int limit = (int)(ds * 0.999);
-    int maxval = 65536;
-    int sum = 0;
-    for (int i=0;i<65536;i++) { if ((sum+=hgram[i])>limit) { maxval = i; break; } }
+    const size_t limit = (size_t)(ds * 0.999);
+    int maxval = u16clamp(Vol3DQuantile::nthValue(vf,limit)*scale);
     vb.makeCompatible(vf);
     uint8 *d = vb.start();
     if (maxval==0)
@@ -122,14 +113,9 @@ double VolumeScaler::scaleToUint8(Vol3D<uint8> &vb, const Vol3D<float64> &vf)
   if (maxValue>0)
   {
     const float64 scale = 65535/(maxValue);
-    std::vector<int> hgram(65536);
-    for (int i=0;i<65536;i++) hgram[i] = 0;
     const int ds = vf.size();
-    for (int i=0;i<ds;i++) hgram[u16clamp(vf[i]*scale)]++;
-    int limit = (int)(ds * 0.999);
-    int maxval = 65536;
-    int sum = 0;
-    for (int i=0;i<65536;i++) { if ((sum+=hgram[i])>limit) { maxval = i; break; } }
+    const size_t limit = (size_t)(ds * 0.999);
+    int maxval = u16clamp(Vol3DQuantile::nthValue(vf,limit)*scale);
     vb.makeCompatible(vf);
     uint8 *d = vb.start();
     if (maxval==0)
@@ -156,15 +142,10 @@ double VolumeScaler::scaleToUint8(Vol3D<uint8> &vb, const Vol3D<float64> &vf)
 
 double VolumeScaler::scaleToUint8(Vol3D<uint8> &vb, const Vol3D<uint16> &vs)
 {
-  std::vector<int> hgram(65536);
-  for (int i=0;i<65536;i++) hgram[i] = 0;
   const int ds = vs.size();
   unsigned short *s = (unsigned short *)vs.start();
-  for (int i=0;i<ds;i++) hgram[s[i]]++;
-  int limit = (int)(ds * 0.999); // take lower 99.9%
-  int maxval = 65536;
-  int sum = 0;
-  for (int i=0;i<65536;i++) { if ((sum+=hgram[i])>limit) { maxval = i; break; } }
+  const size_t limit = (size_t)(ds * 0.999); // take lower 99.9%
+  int maxval = Vol3DQuantile::nthValue(vs,limit);
   vb.makeCompatible(vs);
   uint8 *d = vb.start();
   if (maxval==0)
@@ -182,18 +163,11 @@ double VolumeScaler::scaleToUint8(Vol3D<uint8> &vb, const Vol3D<uint16> &vs)
 
 double VolumeScaler::scaleToUint8(Vol3D<uint8> &vb, const Vol3D<sint16> &vs)
 {
-  std::vector<int> hgram(37268);
-  for (int i=0;i<37268;i++) hgram[i] = 0;
   const int ds = vs.size();
   const auto *s = vs.start();
-  for (int i=0;i<ds;i++)
-  {
-    hgram[(s[i]>0) ? s[i] : 0 ]++;
-  }
-  int limit = (int)(ds * 0.999); // take lower 99.9%
-  int maxval = 32767;
-  int sum = 0;
-  for (int i=0;i<32768;i++) { if ((sum+=hgram[i])>limit) { maxval = i; break; } }
+  const size_t limit = (size_t)(ds * 0.999); // take lower 99.9%, with negative values counted as zero
+  const sint16 nth = Vol3DQuantile::nthValue(vs,limit);
+  int maxval = (nth>0) ? nth : 0;
   vb.makeCompatible(vs);
   uint8 *d = vb.start();
   if (maxval==0)